@@ -0,0 +1,5 @@
+#!/usr/bin/env sh
+
+set -eu
+
+${CC:-clang} -O2 -Isrc/ tests/bench_rss.c -o tests/bench_rss && ./tests/bench_rss "$@"
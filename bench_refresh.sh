@@ -0,0 +1,38 @@
+#!/usr/bin/env sh
+
+set -eu
+
+# NOTE(ariel) Record the fixtures once unless RECORDINGS names a directory of
+# recordings already, e.g. ones the program saved with AGGRSS_RECORD_DIRECTORY.
+# Then replay them with LATENCY milliseconds and BANDWIDTH kilobytes per second.
+PORT="${PORT:-8938}"
+LATENCY="${LATENCY:-50}"
+BANDWIDTH="${BANDWIDTH:-0}"
+
+${CC:-clang} -O2 -Isrc/ tests/bench_refresh.c -pthread -DCONFIG_DIRECTORY_PATH=\"./tests/bench_\" \
+	`curl-config --cflags --libs` `pkg-config --cflags --libs sqlite3` -o tests/bench_refresh
+
+if [ -z "${RECORDINGS:-}" ]
+then
+	RECORDINGS="./tests/recordings"
+	rm -rf "$RECORDINGS"
+	mkdir -p "$RECORDINGS"
+	python3 tests/fixture_server.py "$PORT" > /dev/null &
+	SERVER=$!
+	while ! curl -s -o /dev/null "http://127.0.0.1:$PORT/"; do sleep 0.1; done
+	URLS=""
+	for INPUT in tests/inputs/*
+	do
+		URLS="$URLS http://127.0.0.1:$PORT/gzip/`basename $INPUT`"
+	done
+	./tests/bench_refresh --record "$RECORDINGS" $URLS > /dev/null
+	kill $SERVER
+	wait $SERVER || true
+fi
+
+python3 tests/replay_server.py "$RECORDINGS" --port "$PORT" --latency "$LATENCY" --bandwidth "$BANDWIDTH" &
+SERVER=$!
+trap 'kill $SERVER' EXIT
+while ! curl -s -o /dev/null "http://127.0.0.1:$PORT/"; do sleep 0.1; done
+
+./tests/bench_refresh "http://127.0.0.1:$PORT" "$RECORDINGS" "$@"
@@ -3,11 +3,12 @@ enum
 	ARENA_MEMORY_ALIGNMENT = 32,
 	ARENA_PAGE_SIZE = KB(8),
 };
+#define ARENA_RESERVATION_SIZE GB(4)
 
 static void
 InitializeArena(arena *Arena)
 {
-	Arena->Buffer = ReserveVirtualMemory(GB(4));
+	Arena->Buffer = ReserveVirtualMemory(ARENA_RESERVATION_SIZE);
 	Arena->Capacity = 0;
 	Arena->CurrentOffset = 0;
 	Arena->PreviousOffset = 0;
@@ -18,7 +19,7 @@ static void
 ReleaseArena(arena *Arena)
 {
 	ClearArena(Arena);
-	ReleaseVirtualMemory(Arena->Buffer, Arena->Capacity);
+	ReleaseVirtualMemory(Arena->Buffer, ARENA_RESERVATION_SIZE);
 }
 
 static uintptr
@@ -42,11 +43,17 @@ PushBytesToArena(arena *Arena, u64 Size)
 	Assert(AlignedOffset >= CurrentOffset);
 	AlignedOffset -= (uintptr)Arena->Buffer;
 
-	while(AlignedOffset + Size > Arena->Capacity)
+	// NOTE(ariel) Only commit memory when the arena grows past its capacity.
+	// Clearing or restoring the arena lowers its capacity to match what it
+	// decommits.
+	if(AlignedOffset + Size > Arena->Capacity)
 	{
-		Arena->Capacity += ARENA_PAGE_SIZE;
+		while(AlignedOffset + Size > Arena->Capacity)
+		{
+			Arena->Capacity += ARENA_PAGE_SIZE;
+		}
+		CommitVirtualMemory(Arena->Buffer, Arena->Capacity);
 	}
-	CommitVirtualMemory(Arena->Buffer, Arena->Capacity);
 
 	Arena->PreviousOffset = AlignedOffset;
 	Arena->CurrentOffset = AlignedOffset + Size;
@@ -63,11 +70,14 @@ ReallocFromArena(arena *Arena, u64 Size)
 	Assert(((uintptr)Arena->Buffer + (uintptr)Arena->PreviousOffset) % ARENA_MEMORY_ALIGNMENT == 0);
 	void *Address = 0;
 
-	while(Arena->PreviousOffset + Size > Arena->Capacity)
+	if(Arena->PreviousOffset + Size > Arena->Capacity)
 	{
-		Arena->Capacity += ARENA_PAGE_SIZE;
+		while(Arena->PreviousOffset + Size > Arena->Capacity)
+		{
+			Arena->Capacity += ARENA_PAGE_SIZE;
+		}
+		CommitVirtualMemory(Arena->Buffer, Arena->Capacity);
 	}
-	CommitVirtualMemory(Arena->Buffer, Arena->Capacity);
 
 	Arena->CurrentOffset = Arena->PreviousOffset + Size;
 	Address = &Arena->Buffer[Arena->PreviousOffset];
@@ -122,4 +132,5 @@ RestoreArenaFromCheckpoint(arena_checkpoint Checkpoint)
 
 	DecommitVirtualMemory(BufferOffset, RemainingCapacity);
 	__ASAN_POISON_MEMORY_REGION(BufferOffset, RemainingCapacity);
+	Arena->Capacity = Offset;
 }
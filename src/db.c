@@ -23,6 +23,33 @@ confirm_success(sqlite3 *db, s32 status_code, char *error_message)
 	}
 }
 
+static void
+db_add_column_if_missing(sqlite3 *db, char *table, char *column, char *type)
+{
+	sqlite3_stmt *statement = 0;
+	string select_column = string_literal("SELECT 1 FROM pragma_table_info(?) WHERE name = ?;");
+	sqlite3_prepare_v2(db, select_column.str, select_column.len, &statement, 0);
+	sqlite3_bind_text(statement, 1, table, -1, SQLITE_STATIC);
+	sqlite3_bind_text(statement, 2, column, -1, SQLITE_STATIC);
+	s32 status = sqlite3_step(statement);
+	sqlite3_finalize(statement);
+	confirm_success(db, status, "failed to look up column in database");
+
+	if (status == SQLITE_DONE)
+	{
+		char add_column[256] = {0};
+		snprintf(add_column, sizeof(add_column), "ALTER TABLE %s ADD COLUMN %s %s;", table, column, type);
+
+		char *errmsg = 0;
+		s32 error = sqlite3_exec(db, add_column, 0, 0, &errmsg);
+		if (error)
+		{
+			fprintf(stderr, "[DB ERROR] failed to add column %s to %s table: %s\n", column, table, errmsg);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
 static void
 db_init(sqlite3 **db)
 {
@@ -52,7 +79,15 @@ db_init(sqlite3 **db)
 			"feeds("
 				"id INTEGER PRIMARY KEY,"
 				"link TEXT UNIQUE,"
-				"title TEXT);";
+				"title TEXT,"
+				"etag TEXT,"
+				"last_modified TEXT,"
+				"refresh_interval INTEGER NOT NULL DEFAULT 0,"
+				"skip_hours INTEGER NOT NULL DEFAULT 0,"
+				"next_refresh INTEGER NOT NULL DEFAULT 0,"
+				"failure_count INTEGER NOT NULL DEFAULT 0,"
+				"retry_time INTEGER NOT NULL DEFAULT 0,"
+				"body_hash INTEGER NOT NULL DEFAULT 0);";
 	error = sqlite3_exec(*db, create_feeds_table, 0, 0, &errmsg);
 	if (error)
 	{
@@ -60,6 +95,16 @@ db_init(sqlite3 **db)
 		exit(EXIT_FAILURE);
 	}
 
+	// NOTE(ariel) Tables created by earlier versions lack later columns.
+	db_add_column_if_missing(*db, "feeds", "etag", "TEXT");
+	db_add_column_if_missing(*db, "feeds", "last_modified", "TEXT");
+	db_add_column_if_missing(*db, "feeds", "refresh_interval", "INTEGER NOT NULL DEFAULT 0");
+	db_add_column_if_missing(*db, "feeds", "skip_hours", "INTEGER NOT NULL DEFAULT 0");
+	db_add_column_if_missing(*db, "feeds", "next_refresh", "INTEGER NOT NULL DEFAULT 0");
+	db_add_column_if_missing(*db, "feeds", "failure_count", "INTEGER NOT NULL DEFAULT 0");
+	db_add_column_if_missing(*db, "feeds", "retry_time", "INTEGER NOT NULL DEFAULT 0");
+	db_add_column_if_missing(*db, "feeds", "body_hash", "INTEGER NOT NULL DEFAULT 0");
+
 	errmsg = 0;
 	char *create_items_table =
 		"CREATE TABLE IF NOT EXISTS "
@@ -132,13 +177,27 @@ db_free(sqlite3 *db)
 	confirm_success(db, status, "failed to close database");
 }
 
+static void
+db_begin_transaction(sqlite3 *db)
+{
+	s32 status = sqlite3_exec(db, "BEGIN;", 0, 0, 0);
+	confirm_success(db, status, "failed to begin transaction");
+}
+
+static void
+db_end_transaction(sqlite3 *db)
+{
+	s32 status = sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+	confirm_success(db, status, "failed to commit transaction");
+}
+
 static void
 db_add_feed(sqlite3 *db, string feed_link, string feed_title)
 {
 	u32 feed_id = db_hash(feed_link);
 
 	sqlite3_stmt *statement = 0;
-	string insert_feed = string_literal("INSERT INTO feeds VALUES(?, ?, ?);");
+	string insert_feed = string_literal("INSERT INTO feeds(id, link, title) VALUES(?, ?, ?);");
 	sqlite3_prepare_v2(db, insert_feed.str, insert_feed.len, &statement, 0);
 	sqlite3_bind_int(statement, 1, feed_id);
 	sqlite3_bind_text(statement, 2, feed_link.str, feed_link.len, SQLITE_STATIC);
@@ -156,7 +215,7 @@ db_add_or_update_feed(sqlite3 *db, string feed_link, string feed_title)
 
 	sqlite3_stmt *statement = 0;
 	string insert_feed = string_literal(
-		"INSERT INTO feeds VALUES(?, ?, ?) ON CONFLICT(link) DO UPDATE SET title=excluded.title;");
+		"INSERT INTO feeds(id, link, title) VALUES(?, ?, ?) ON CONFLICT(link) DO UPDATE SET title=excluded.title;");
 	sqlite3_prepare_v2(db, insert_feed.str, insert_feed.len, &statement, 0);
 	sqlite3_bind_int(statement, 1, feed_id);
 	sqlite3_bind_text(statement, 2, feed_link.str, feed_link.len, SQLITE_STATIC);
@@ -167,18 +226,166 @@ db_add_or_update_feed(sqlite3 *db, string feed_link, string feed_title)
 	confirm_success(db, status, "failed to add or update feed in database");
 }
 
-static inline void
-get_content_from_node(RSS_Tree_Node *item_node, string term, string default_value, string *value)
+static void
+db_get_feed_validators(sqlite3 *db, arena *Arena, string feed_link, string *etag, string *last_modified)
 {
-	RSS_Tree_Node *node = find_item_child_node(item_node, term);
-	if (node)
+	u32 feed_id = db_hash(feed_link);
+
+	sqlite3_stmt *statement = 0;
+	string select_validators = string_literal("SELECT etag, last_modified FROM feeds WHERE id = ?;");
+	sqlite3_prepare_v2(db, select_validators.str, select_validators.len, &statement, 0);
+	sqlite3_bind_int(statement, 1, feed_id);
+	s32 status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
 	{
-		*value = node->content;
+		// NOTE(ariel) Copy the validators since SQLite frees its copies when the
+		// statement finalizes.
+		string stored_etag = { (char *)sqlite3_column_text(statement, 0), sqlite3_column_bytes(statement, 0) };
+		string stored_last_modified = { (char *)sqlite3_column_text(statement, 1), sqlite3_column_bytes(statement, 1) };
+		*etag = string_duplicate(Arena, stored_etag);
+		*last_modified = string_duplicate(Arena, stored_last_modified);
 	}
-	else
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to get validators of feed from database");
+}
+
+static void
+db_set_feed_validators(sqlite3 *db, string feed_link, string etag, string last_modified)
+{
+	u32 feed_id = db_hash(feed_link);
+
+	// NOTE(ariel) Store NULL rather than an empty string for a validator the
+	// server didn't send.
+	sqlite3_stmt *statement = 0;
+	string update_feed = string_literal("UPDATE feeds SET etag = ?, last_modified = ? WHERE id = ?;");
+	sqlite3_prepare_v2(db, update_feed.str, update_feed.len, &statement, 0);
+	sqlite3_bind_text(statement, 1, etag.str, etag.len, SQLITE_STATIC);
+	sqlite3_bind_text(statement, 2, last_modified.str, last_modified.len, SQLITE_STATIC);
+	sqlite3_bind_int(statement, 3, feed_id);
+	s32 status = sqlite3_step(statement);
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to set validators of feed in database");
+}
+
+static b32
+db_get_feed_schedule(sqlite3 *db, string feed_link, s64 *refresh_interval, u32 *skip_hours, s64 *next_refresh)
+{
+	b32 feed_exists = false;
+	u32 feed_id = db_hash(feed_link);
+
+	sqlite3_stmt *statement = 0;
+	string select_schedule = string_literal("SELECT refresh_interval, skip_hours, next_refresh FROM feeds WHERE id = ?;");
+	sqlite3_prepare_v2(db, select_schedule.str, select_schedule.len, &statement, 0);
+	sqlite3_bind_int(statement, 1, feed_id);
+	s32 status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
 	{
-		*value = default_value;
+		feed_exists = true;
+		*refresh_interval = sqlite3_column_int64(statement, 0);
+		*skip_hours = (u32)sqlite3_column_int64(statement, 1);
+		*next_refresh = sqlite3_column_int64(statement, 2);
 	}
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to get schedule of feed from database");
+	return feed_exists;
+}
+
+static void
+db_set_feed_schedule(sqlite3 *db, string feed_link, s64 refresh_interval, u32 skip_hours, s64 next_refresh)
+{
+	u32 feed_id = db_hash(feed_link);
+
+	sqlite3_stmt *statement = 0;
+	string update_feed = string_literal(
+		"UPDATE feeds SET refresh_interval = ?, skip_hours = ?, next_refresh = ? WHERE id = ?;");
+	sqlite3_prepare_v2(db, update_feed.str, update_feed.len, &statement, 0);
+	sqlite3_bind_int64(statement, 1, refresh_interval);
+	sqlite3_bind_int64(statement, 2, skip_hours);
+	sqlite3_bind_int64(statement, 3, next_refresh);
+	sqlite3_bind_int(statement, 4, feed_id);
+	s32 status = sqlite3_step(statement);
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to set schedule of feed in database");
+}
+
+static void
+db_get_feed_failures(sqlite3 *db, string feed_link, s32 *failure_count, s64 *retry_time)
+{
+	u32 feed_id = db_hash(feed_link);
+
+	sqlite3_stmt *statement = 0;
+	string select_failures = string_literal("SELECT failure_count, retry_time FROM feeds WHERE id = ?;");
+	sqlite3_prepare_v2(db, select_failures.str, select_failures.len, &statement, 0);
+	sqlite3_bind_int(statement, 1, feed_id);
+	s32 status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		*failure_count = sqlite3_column_int(statement, 0);
+		*retry_time = sqlite3_column_int64(statement, 1);
+	}
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to get failures of feed from database");
+}
+
+static void
+db_set_feed_failures(sqlite3 *db, string feed_link, s32 failure_count, s64 retry_time)
+{
+	u32 feed_id = db_hash(feed_link);
+
+	sqlite3_stmt *statement = 0;
+	string update_feed = string_literal("UPDATE feeds SET failure_count = ?, retry_time = ? WHERE id = ?;");
+	sqlite3_prepare_v2(db, update_feed.str, update_feed.len, &statement, 0);
+	sqlite3_bind_int(statement, 1, failure_count);
+	sqlite3_bind_int64(statement, 2, retry_time);
+	sqlite3_bind_int(statement, 3, feed_id);
+	s32 status = sqlite3_step(statement);
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to set failures of feed in database");
+}
+
+static u64
+db_get_feed_body_hash(sqlite3 *db, string feed_link)
+{
+	u32 feed_id = db_hash(feed_link);
+	u64 body_hash = 0;
+
+	sqlite3_stmt *statement = 0;
+	string select_body_hash = string_literal("SELECT body_hash FROM feeds WHERE id = ?;");
+	sqlite3_prepare_v2(db, select_body_hash.str, select_body_hash.len, &statement, 0);
+	sqlite3_bind_int(statement, 1, feed_id);
+	s32 status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		// NOTE(ariel) SQLite only stores signed integers, so the hash round trips
+		// through s64.
+		body_hash = (u64)sqlite3_column_int64(statement, 0);
+	}
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to get body hash of feed from database");
+	return body_hash;
+}
+
+static void
+db_set_feed_body_hash(sqlite3 *db, string feed_link, u64 body_hash)
+{
+	u32 feed_id = db_hash(feed_link);
+
+	sqlite3_stmt *statement = 0;
+	string update_feed = string_literal("UPDATE feeds SET body_hash = ? WHERE id = ?;");
+	sqlite3_prepare_v2(db, update_feed.str, update_feed.len, &statement, 0);
+	sqlite3_bind_int64(statement, 1, (s64)body_hash);
+	sqlite3_bind_int(statement, 2, feed_id);
+	s32 status = sqlite3_step(statement);
+	sqlite3_finalize(statement);
+
+	confirm_success(db, status, "failed to set body hash of feed in database");
 }
 
 static u64
@@ -196,18 +403,12 @@ get_unix_timestamp(string feed_link, string date_time)
 	return timestamp.unix_format;
 }
 
-static void
-db_add_item(sqlite3 *db, string feed_link, RSS_Tree_Node *item_node)
+static b32
+db_add_item(sqlite3 *db, string feed_link, RSS_Item *item)
 {
-	string link = find_link(item_node);
-
-	string title = {0};
-	get_content_from_node(item_node, string_literal("title"), title, &title);
-
-	string date = {0};
-	get_content_from_node(item_node, string_literal("pubDate"), date, &date);
-	get_content_from_node(item_node, string_literal("updated"), date, &date);
-	s64 unix_timestamp = get_unix_timestamp(feed_link, date);
+	string link = item->link;
+	string title = item->title;
+	s64 unix_timestamp = get_unix_timestamp(feed_link, item->date);
 
 	// NOTE(ariel) 1 in the VALUES(...) expression below indicates the item
 	// remains unread.
@@ -223,6 +424,8 @@ db_add_item(sqlite3 *db, string feed_link, RSS_Tree_Node *item_node)
 	sqlite3_finalize(statement);
 
 	confirm_success(db, status, "failed to add item to database");
+	b32 added = status == SQLITE_DONE && sqlite3_changes(db) > 0;
+	return added;
 }
 
 static void
@@ -377,14 +580,14 @@ db_filter_feeds_by_tag(sqlite3 *db, string *feed_link, string *feed_title, Strin
 }
 
 static b32
-db_iterate_feeds(sqlite3 *db, string *feed_link, string *feed_title)
+db_iterate_feeds(sqlite3 *db, string *feed_link, string *feed_title, s32 *failure_count, s64 *retry_time)
 {
 	b32 feed_exists = false;
 
 	local_persist sqlite3_stmt *select_statement = 0;
 	if (!select_statement)
 	{
-		string select_feeds = string_literal("SELECT link, title FROM feeds;");
+		string select_feeds = string_literal("SELECT link, title, failure_count, retry_time FROM feeds;");
 		sqlite3_prepare_v2(db, select_feeds.str, select_feeds.len, &select_statement, 0);
 	}
 
@@ -396,6 +599,38 @@ db_iterate_feeds(sqlite3 *db, string *feed_link, string *feed_title)
 		feed_link->len = sqlite3_column_bytes(select_statement, LINK_COLUMN);
 		feed_title->str = (char *)sqlite3_column_text(select_statement, TITLE_COLUMN);
 		feed_title->len = sqlite3_column_bytes(select_statement, TITLE_COLUMN);
+		*failure_count = sqlite3_column_int(select_statement, 2);
+		*retry_time = sqlite3_column_int64(select_statement, 3);
+	}
+
+	if (!feed_exists)
+	{
+		sqlite3_finalize(select_statement);
+		select_statement = 0;
+	}
+
+	return feed_exists;
+}
+
+static b32
+db_iterate_feed_schedule(sqlite3 *db, string *feed_link, s64 *next_refresh)
+{
+	b32 feed_exists = false;
+
+	local_persist sqlite3_stmt *select_statement = 0;
+	if (!select_statement)
+	{
+		string select_feeds = string_literal("SELECT link, next_refresh FROM feeds;");
+		sqlite3_prepare_v2(db, select_feeds.str, select_feeds.len, &select_statement, 0);
+	}
+
+	s32 status = sqlite3_step(select_statement);
+	if (status == SQLITE_ROW)
+	{
+		feed_exists = true;
+		feed_link->str = (char *)sqlite3_column_text(select_statement, LINK_COLUMN);
+		feed_link->len = sqlite3_column_bytes(select_statement, LINK_COLUMN);
+		*next_refresh = sqlite3_column_int64(select_statement, 1);
 	}
 
 	if (!feed_exists)
@@ -14,11 +14,38 @@ static void db_free(sqlite3 *db);
 
 static s32 db_count_rows(sqlite3 *db);
 
+// NOTE(ariel) Group writes so that SQLite syncs them to disk once rather than
+// once per statement.
+static void db_begin_transaction(sqlite3 *db);
+static void db_end_transaction(sqlite3 *db);
+
 static void db_add_feed(sqlite3 *db, string feed_link, string feed_title);
 static void db_add_or_update_feed(sqlite3 *db, string feed_link, string feed_title);
-static void db_add_item(sqlite3 *db, string feed_link, RSS_Tree_Node *item_node);
+// NOTE(ariel) db_add_item() returns true if the item wasn't stored already.
+static b32 db_add_item(sqlite3 *db, string feed_link, RSS_Item *item);
 static void db_tag_feed(sqlite3 *db, string tag, string feed_title);
 
+// NOTE(ariel) Validators are the ETag and Last-Modified headers of the last
+// response that parsed successfully. Either may be empty.
+static void db_get_feed_validators(sqlite3 *db, arena *Arena, string feed_link, string *etag, string *last_modified);
+static void db_set_feed_validators(sqlite3 *db, string feed_link, string etag, string last_modified);
+
+// NOTE(ariel) The schedule of a feed holds the interval and hours to skip it
+// was last refreshed with and when it next falls due. Feeds never refreshed
+// fall due at time 0.
+static b32 db_get_feed_schedule(sqlite3 *db, string feed_link, s64 *refresh_interval, u32 *skip_hours, s64 *next_refresh);
+static void db_set_feed_schedule(sqlite3 *db, string feed_link, s64 refresh_interval, u32 skip_hours, s64 next_refresh);
+
+// NOTE(ariel) Failures count consecutive failed refreshes of a feed, and the
+// retry time marks the end of its backoff.
+static void db_get_feed_failures(sqlite3 *db, string feed_link, s32 *failure_count, s64 *retry_time);
+static void db_set_feed_failures(sqlite3 *db, string feed_link, s32 failure_count, s64 retry_time);
+
+// NOTE(ariel) The body hash is the hash of the last response body that parsed
+// successfully, or 0 if none did.
+static u64 db_get_feed_body_hash(sqlite3 *db, string feed_link);
+static void db_set_feed_body_hash(sqlite3 *db, string feed_link, u64 body_hash);
+
 static void db_del_feed(sqlite3 *db, string feed_link);
 
 static void db_mark_item_read(sqlite3 *db, string item_link);
@@ -27,7 +54,8 @@ static void db_mark_all_read(sqlite3 *db, string feed_link);
 // NOTE(ariel) The following functions assume one and only one thread calls
 // them until exhaustion.
 static b32 db_filter_feeds_by_tag(sqlite3 *db, string *feed_link, string *feed_title, String_List tags);
-static b32 db_iterate_feeds(sqlite3 *db, string *feed_link, string *feed_title);
+static b32 db_iterate_feeds(sqlite3 *db, string *feed_link, string *feed_title, s32 *failure_count, s64 *retry_time);
+static b32 db_iterate_feed_schedule(sqlite3 *db, string *feed_link, s64 *next_refresh);
 static b32 db_iterate_items(sqlite3 *db, string feed_link, DB_Item *item);
 static b32 db_iterate_tags(sqlite3 *db, string *tag);
 
@@ -0,0 +1,620 @@
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum { UNICODE_REPLACEMENT_CHARACTER = 0xfffd };
+
+/* ---
+ * Encoding Detection
+ * ---
+ */
+
+static b32
+match_encoding_label(string label, char *name)
+{
+	s32 len = (s32)strlen(name);
+	if (label.len != len)
+	{
+		return false;
+	}
+	for (s32 i = 0; i < len; ++i)
+	{
+		if (tolower((unsigned char)label.str[i]) != name[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static b32
+encoding_from_label(string label, Text_Encoding *encoding)
+{
+	local_persist char *utf8_labels[] = { "utf-8", "utf8", "unicode-1-1-utf-8" };
+	local_persist char *windows_1252_labels[] =
+	{
+		// NOTE(ariel) Like browsers, treat ISO-8859-1 and ASCII as windows-1252.
+		// The encodings only differ in bytes 0x80 to 0x9f, which are control
+		// characters in ISO-8859-1 that feeds never mean to use.
+		"windows-1252", "cp1252", "x-cp1252",
+		"iso-8859-1", "iso8859-1", "iso_8859-1", "latin1", "l1",
+		"us-ascii", "ascii",
+	};
+
+	for (s32 i = 0; i < (s32)ARRAY_COUNT(utf8_labels); ++i)
+	{
+		if (match_encoding_label(label, utf8_labels[i]))
+		{
+			*encoding = TEXT_ENCODING_UTF8;
+			return true;
+		}
+	}
+	for (s32 i = 0; i < (s32)ARRAY_COUNT(windows_1252_labels); ++i)
+	{
+		if (match_encoding_label(label, windows_1252_labels[i]))
+		{
+			*encoding = TEXT_ENCODING_WINDOWS_1252;
+			return true;
+		}
+	}
+	if (match_encoding_label(label, "utf-16le"))
+	{
+		*encoding = TEXT_ENCODING_UTF16LE;
+		return true;
+	}
+	if (match_encoding_label(label, "utf-16be") || match_encoding_label(label, "utf-16"))
+	{
+		*encoding = TEXT_ENCODING_UTF16BE;
+		return true;
+	}
+
+	return false;
+}
+
+static string
+find_content_type_charset(string content_type)
+{
+	string charset = {0};
+
+	string parameter = string_literal("charset");
+	for (s32 i = 0; i + parameter.len < content_type.len; ++i)
+	{
+		if (match_encoding_label(string_substr(content_type, i, parameter.len), (char *)parameter.str))
+		{
+			s32 cursor = i + parameter.len;
+			while (cursor < content_type.len && content_type.str[cursor] == ' ') ++cursor;
+			if (cursor == content_type.len || content_type.str[cursor] != '=') continue;
+			++cursor;
+			while (cursor < content_type.len && content_type.str[cursor] == ' ') ++cursor;
+			if (cursor < content_type.len && content_type.str[cursor] == '"') ++cursor;
+
+			s32 end = cursor;
+			while (end < content_type.len && content_type.str[end] != ';' &&
+				content_type.str[end] != '"' && content_type.str[end] != ' ')
+			{
+				++end;
+			}
+			charset = string_substr(content_type, cursor, end - cursor);
+			break;
+		}
+	}
+
+	return charset;
+}
+
+static string
+find_declared_encoding(string head)
+{
+	string encoding = {0};
+
+	// NOTE(ariel) The XML declaration, if any, must open the document.
+	string declaration_start = string_literal("<?xml");
+	if (head.len < declaration_start.len || !string_match(string_prefix(head, declaration_start.len), declaration_start))
+	{
+		return encoding;
+	}
+
+	s32 declaration_end = string_find_substr(string_prefix(head, MIN(head.len, 1024)), string_literal("?>"));
+	if (declaration_end == -1)
+	{
+		return encoding;
+	}
+
+	string declaration = string_prefix(head, declaration_end);
+	s32 attribute = string_find_substr(declaration, string_literal("encoding"));
+	if (attribute != -1)
+	{
+		s32 cursor = attribute + (s32)sizeof("encoding") - 1;
+		while (cursor < declaration.len && isspace((unsigned char)declaration.str[cursor])) ++cursor;
+		if (cursor < declaration.len && declaration.str[cursor] == '=')
+		{
+			++cursor;
+			while (cursor < declaration.len && isspace((unsigned char)declaration.str[cursor])) ++cursor;
+			if (cursor < declaration.len && (declaration.str[cursor] == '"' || declaration.str[cursor] == '\''))
+			{
+				char quote = declaration.str[cursor++];
+				s32 end = cursor;
+				while (end < declaration.len && declaration.str[end] != quote) ++end;
+				encoding = string_substr(declaration, cursor, end - cursor);
+			}
+		}
+	}
+
+	return encoding;
+}
+
+static s32
+byte_order_mark_length(string head, Text_Encoding *encoding)
+{
+	u8 *bytes = (u8 *)head.str;
+	if (head.len >= 3 && bytes[0] == 0xef && bytes[1] == 0xbb && bytes[2] == 0xbf)
+	{
+		*encoding = TEXT_ENCODING_UTF8;
+		return 3;
+	}
+	if (head.len >= 2 && bytes[0] == 0xff && bytes[1] == 0xfe)
+	{
+		*encoding = TEXT_ENCODING_UTF16LE;
+		return 2;
+	}
+	if (head.len >= 2 && bytes[0] == 0xfe && bytes[1] == 0xff)
+	{
+		*encoding = TEXT_ENCODING_UTF16BE;
+		return 2;
+	}
+	return 0;
+}
+
+static Text_Encoding
+detect_encoding(string head, string content_type)
+{
+	Text_Encoding encoding = TEXT_ENCODING_UTF8;
+	if (byte_order_mark_length(head, &encoding))
+	{
+		return encoding;
+	}
+
+	// NOTE(ariel) A document in UTF-16 without a byte order mark still opens
+	// with "<?", which reveals the order of its bytes.
+	u8 *bytes = (u8 *)head.str;
+	b32 looks_like_utf16le = head.len >= 4 && bytes[0] == '<' && bytes[1] == 0 && bytes[2] == '?' && bytes[3] == 0;
+	b32 looks_like_utf16be = head.len >= 4 && bytes[0] == 0 && bytes[1] == '<' && bytes[2] == 0 && bytes[3] == '?';
+
+	if (encoding_from_label(find_content_type_charset(content_type), &encoding))
+	{
+		if (encoding == TEXT_ENCODING_UTF16BE && looks_like_utf16le)
+		{
+			encoding = TEXT_ENCODING_UTF16LE;
+		}
+	}
+	else if (looks_like_utf16le)
+	{
+		encoding = TEXT_ENCODING_UTF16LE;
+	}
+	else if (looks_like_utf16be)
+	{
+		encoding = TEXT_ENCODING_UTF16BE;
+	}
+	else if (!encoding_from_label(find_declared_encoding(head), &encoding))
+	{
+		encoding = TEXT_ENCODING_UTF8;
+	}
+
+	return encoding;
+}
+
+static void
+begin_transcode(UTF8_Transcoder *transcoder, string head, string content_type)
+{
+	MEM_ZERO_STRUCT(transcoder);
+	transcoder->encoding = detect_encoding(head, content_type);
+
+	// NOTE(ariel) Drop the byte order mark since the output is always UTF-8.
+	Text_Encoding marked_encoding = TEXT_ENCODING_UTF8;
+	s32 mark_length = byte_order_mark_length(head, &marked_encoding);
+	if (marked_encoding == transcoder->encoding)
+	{
+		transcoder->bytes_to_skip = mark_length;
+	}
+}
+
+/* ---
+ * Transcoding
+ * ---
+ */
+
+// NOTE(ariel) These kernels return the offset of the first byte or code unit
+// outside of ASCII at or after `offset`. They check 32 bytes at a time with
+// AVX2, 16 bytes at a time with SSE2, and finish the tail one at a time.
+
+static s32
+scan_past_ascii(string s, s32 offset)
+{
+	s32 index = offset;
+
+#if defined(__AVX2__)
+	for (; index + 32 <= s.len; index += 32)
+	{
+		__m256i chunk = _mm256_loadu_si256((__m256i *)(s.str + index));
+		u32 mask = (u32)_mm256_movemask_epi8(chunk);
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	for (; index + 16 <= s.len; index += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((__m128i *)(s.str + index));
+		u32 mask = (u32)_mm_movemask_epi8(chunk);
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	while (index < s.len && (u8)s.str[index] < 0x80)
+	{
+		++index;
+	}
+	return index;
+}
+
+static s32
+narrow_utf16_ascii(string s, s32 offset, b32 big_endian, u8 *destination)
+{
+	s32 index = offset;
+
+	// NOTE(ariel) Narrow eight code units at a time while all of them are ASCII.
+	// AVX2 packs within 128-bit lanes, so it gains nothing over SSE2 here.
+#if defined(__SSE2__)
+	__m128i non_ascii_bits = _mm_set1_epi16(big_endian ? (s16)0x80ff : (s16)0xff80);
+	__m128i zero = _mm_setzero_si128();
+	for (; index + 16 <= s.len; index += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((__m128i *)(s.str + index));
+		__m128i is_ascii = _mm_cmpeq_epi8(_mm_and_si128(chunk, non_ascii_bits), zero);
+		if (_mm_movemask_epi8(is_ascii) != 0xffff)
+		{
+			break;
+		}
+		if (big_endian)
+		{
+			chunk = _mm_or_si128(_mm_srli_epi16(chunk, 8), _mm_slli_epi16(chunk, 8));
+		}
+		_mm_storel_epi64((__m128i *)destination, _mm_packus_epi16(chunk, chunk));
+		destination += 8;
+	}
+#endif
+
+	for (; index + 2 <= s.len; index += 2)
+	{
+		u8 high = (u8)s.str[index + !big_endian];
+		u8 low = (u8)s.str[index + big_endian];
+		if (high || low >= 0x80)
+		{
+			break;
+		}
+		*destination++ = low;
+	}
+	return index;
+}
+
+typedef struct Decoded_Character Decoded_Character;
+struct Decoded_Character
+{
+	s32 code_point;
+	s32 length;
+	b32 incomplete;
+};
+
+static Decoded_Character
+decode_utf8_character(u8 *bytes, s32 available)
+{
+	Decoded_Character result = { .code_point = UNICODE_REPLACEMENT_CHARACTER, .length = 1 };
+
+	// NOTE(ariel) Reject overlong forms, surrogates, and code points past
+	// U+10FFFF by narrowing the range of the second byte. An invalid sequence
+	// becomes one replacement character for its longest valid prefix.
+	u8 lead = bytes[0];
+	s32 expected = 0;
+	u8 low = 0x80;
+	u8 high = 0xbf;
+	if (lead < 0x80)
+	{
+		result.code_point = lead;
+		return result;
+	}
+	else if (lead >= 0xc2 && lead <= 0xdf)
+	{
+		expected = 2;
+	}
+	else if (lead >= 0xe0 && lead <= 0xef)
+	{
+		expected = 3;
+		if (lead == 0xe0) low = 0xa0;
+		if (lead == 0xed) high = 0x9f;
+	}
+	else if (lead >= 0xf0 && lead <= 0xf4)
+	{
+		expected = 4;
+		if (lead == 0xf0) low = 0x90;
+		if (lead == 0xf4) high = 0x8f;
+	}
+	else
+	{
+		return result;
+	}
+
+	s32 code_point = lead & (0x7f >> expected);
+	for (s32 index = 1; index < expected; ++index)
+	{
+		if (index == available)
+		{
+			result.incomplete = true;
+			result.length = index;
+			return result;
+		}
+
+		u8 byte = bytes[index];
+		if (byte < low || byte > high)
+		{
+			result.length = index;
+			return result;
+		}
+		code_point = (code_point << 6) | (byte & 0x3f);
+		low = 0x80;
+		high = 0xbf;
+	}
+
+	result.code_point = code_point;
+	result.length = expected;
+	return result;
+}
+
+static Decoded_Character
+decode_utf16_character(u8 *bytes, s32 available, b32 big_endian)
+{
+	Decoded_Character result = { .code_point = UNICODE_REPLACEMENT_CHARACTER, .length = 2 };
+
+	if (available < 2)
+	{
+		result.incomplete = true;
+		result.length = available;
+		return result;
+	}
+
+	s32 unit = big_endian ? (bytes[0] << 8 | bytes[1]) : (bytes[1] << 8 | bytes[0]);
+	if (unit < 0xd800 || unit > 0xdfff)
+	{
+		result.code_point = unit;
+	}
+	else if (unit <= 0xdbff)
+	{
+		if (available < 4)
+		{
+			result.incomplete = true;
+			result.length = available;
+		}
+		else
+		{
+			s32 trail = big_endian ? (bytes[2] << 8 | bytes[3]) : (bytes[3] << 8 | bytes[2]);
+			if (trail >= 0xdc00 && trail <= 0xdfff)
+			{
+				result.code_point = 0x10000 + ((unit - 0xd800) << 10) + (trail - 0xdc00);
+				result.length = 4;
+			}
+		}
+	}
+
+	return result;
+}
+
+static Decoded_Character
+decode_windows_1252_character(u8 byte)
+{
+	local_persist u16 control_range[32] =
+	{
+		0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+		0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+		0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+		0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178,
+	};
+
+	Decoded_Character result = { .code_point = byte, .length = 1 };
+	if (byte >= 0x80 && byte < 0xa0)
+	{
+		result.code_point = control_range[byte - 0x80];
+	}
+	return result;
+}
+
+static Decoded_Character
+decode_character(Text_Encoding encoding, u8 *bytes, s32 available)
+{
+	Decoded_Character result = {0};
+	switch (encoding)
+	{
+		case TEXT_ENCODING_UTF8:         result = decode_utf8_character(bytes, available); break;
+		case TEXT_ENCODING_UTF16LE:      result = decode_utf16_character(bytes, available, false); break;
+		case TEXT_ENCODING_UTF16BE:      result = decode_utf16_character(bytes, available, true); break;
+		case TEXT_ENCODING_WINDOWS_1252: result = decode_windows_1252_character(bytes[0]); break;
+		default: assert(!"unreachable");
+	}
+	return result;
+}
+
+static s32
+encode_utf8(s32 code_point, u8 *destination)
+{
+	if (code_point < 0x80)
+	{
+		destination[0] = (u8)code_point;
+		return 1;
+	}
+	else if (code_point < 0x800)
+	{
+		destination[0] = (u8)(0xc0 | (code_point >> 6));
+		destination[1] = (u8)(0x80 | (code_point & 0x3f));
+		return 2;
+	}
+	else if (code_point < 0x10000)
+	{
+		destination[0] = (u8)(0xe0 | (code_point >> 12));
+		destination[1] = (u8)(0x80 | ((code_point >> 6) & 0x3f));
+		destination[2] = (u8)(0x80 | (code_point & 0x3f));
+		return 3;
+	}
+	else
+	{
+		destination[0] = (u8)(0xf0 | (code_point >> 18));
+		destination[1] = (u8)(0x80 | ((code_point >> 12) & 0x3f));
+		destination[2] = (u8)(0x80 | ((code_point >> 6) & 0x3f));
+		destination[3] = (u8)(0x80 | (code_point & 0x3f));
+		return 4;
+	}
+}
+
+static s32
+transcode_to_utf8(UTF8_Transcoder *transcoder, char *destination, string source, b32 is_last)
+{
+	u8 *output = (u8 *)destination;
+	s32 written = 0;
+
+	s32 cursor = MIN(transcoder->bytes_to_skip, source.len);
+	transcoder->bytes_to_skip -= cursor;
+
+	// NOTE(ariel) Finish the character split across the previous piece and this
+	// one first. Once a piece holds the rest of it, or holds at least four more
+	// bytes, the character is no longer incomplete.
+	while (transcoder->pending_count > 0)
+	{
+		u8 head[8] = {0};
+		s32 from_source = MIN(source.len - cursor, (s32)sizeof(head) - transcoder->pending_count);
+		memcpy(head, transcoder->pending, transcoder->pending_count);
+		if (from_source)
+		{
+			memcpy(head + transcoder->pending_count, source.str + cursor, from_source);
+		}
+		s32 available = transcoder->pending_count + from_source;
+
+		Decoded_Character character = decode_character(transcoder->encoding, head, available);
+		if (character.incomplete)
+		{
+			if (!is_last)
+			{
+				memcpy(transcoder->pending, head, available);
+				transcoder->pending_count = available;
+				return written;
+			}
+			character.length = available;
+		}
+		written += encode_utf8(character.code_point, output + written);
+
+		if (character.length >= transcoder->pending_count)
+		{
+			cursor += character.length - transcoder->pending_count;
+			transcoder->pending_count = 0;
+		}
+		else
+		{
+			transcoder->pending_count -= character.length;
+			memmove(transcoder->pending, transcoder->pending + character.length, transcoder->pending_count);
+		}
+	}
+
+	b32 is_utf16 = transcoder->encoding == TEXT_ENCODING_UTF16LE || transcoder->encoding == TEXT_ENCODING_UTF16BE;
+	b32 big_endian = transcoder->encoding == TEXT_ENCODING_UTF16BE;
+	while (cursor < source.len)
+	{
+		// NOTE(ariel) Copy runs of ASCII in bulk and only decode the characters
+		// between them one at a time.
+		s32 start = cursor;
+		if (is_utf16)
+		{
+			cursor = narrow_utf16_ascii(source, cursor, big_endian, output + written);
+			written += (cursor - start) / 2;
+		}
+		else
+		{
+			cursor = scan_past_ascii(source, cursor);
+			memcpy(output + written, source.str + start, cursor - start);
+			written += cursor - start;
+		}
+		if (cursor == source.len)
+		{
+			break;
+		}
+
+		Decoded_Character character = decode_character(transcoder->encoding, (u8 *)source.str + cursor, source.len - cursor);
+		if (character.incomplete)
+		{
+			if (!is_last)
+			{
+				transcoder->pending_count = source.len - cursor;
+				memcpy(transcoder->pending, source.str + cursor, transcoder->pending_count);
+				break;
+			}
+			character.length = source.len - cursor;
+		}
+		written += encode_utf8(character.code_point, output + written);
+		cursor += character.length;
+	}
+
+	return written;
+}
+
+static string
+transcode_document_to_utf8(arena *Arena, string source, string content_type)
+{
+	UTF8_Transcoder transcoder = {0};
+	begin_transcode(&transcoder, source, content_type);
+
+	// NOTE(ariel) Reserve the largest possible output and then return what
+	// transcoding doesn't use to the arena.
+	string result = {0};
+	result.str = PushBytesToArena(Arena, 0);
+	result.str = ReallocFromArena(Arena, MAX_TRANSCODED_SIZE(source.len));
+	result.len = transcode_to_utf8(&transcoder, result.str, source, true);
+	result.str = ReallocFromArena(Arena, result.len);
+	return result;
+}
+
+static b32
+view_utf8_document(string source, string *view)
+{
+	if (detect_encoding(source, (string){0}) != TEXT_ENCODING_UTF8)
+	{
+		return false;
+	}
+
+	Text_Encoding marked_encoding = TEXT_ENCODING_UTF8;
+	s32 mark_length = byte_order_mark_length(source, &marked_encoding);
+	s32 cursor = mark_length;
+	while (cursor < source.len)
+	{
+		cursor = scan_past_ascii(source, cursor);
+		if (cursor == source.len)
+		{
+			break;
+		}
+
+		// NOTE(ariel) The decoder returns a replacement character for invalid
+		// sequences, so only a literal U+FFFD may decode to one.
+		u8 *bytes = (u8 *)source.str + cursor;
+		Decoded_Character character = decode_utf8_character(bytes, source.len - cursor);
+		b32 literal_replacement = character.length == 3 && bytes[0] == 0xef && bytes[1] == 0xbf && bytes[2] == 0xbd;
+		if (character.incomplete || (character.code_point == UNICODE_REPLACEMENT_CHARACTER && !literal_replacement))
+		{
+			return false;
+		}
+		cursor += character.length;
+	}
+
+	*view = string_substr(source, mark_length, source.len - mark_length);
+	return true;
+}
@@ -0,0 +1,47 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+typedef u8 Text_Encoding;
+enum
+{
+	TEXT_ENCODING_UTF8,
+	TEXT_ENCODING_UTF16LE,
+	TEXT_ENCODING_UTF16BE,
+	TEXT_ENCODING_WINDOWS_1252,
+};
+
+// NOTE(ariel) A transcoder converts a document to UTF-8 as it arrives piece by
+// piece. It holds the bytes of a character split across pieces until the rest
+// of the character arrives.
+typedef struct UTF8_Transcoder UTF8_Transcoder;
+struct UTF8_Transcoder
+{
+	Text_Encoding encoding;
+	s32 bytes_to_skip;
+	s32 pending_count;
+	u8 pending[4];
+};
+
+// NOTE(ariel) Transcoding never writes more than this many bytes for `len`
+// bytes of input plus whatever the transcoder held from earlier input.
+#define MAX_TRANSCODED_SIZE(len) (3*((len) + 4))
+
+// NOTE(ariel) Determine the encoding of a document from its byte order mark,
+// then the charset of its Content-Type (which may be empty), then its XML
+// declaration. Documents that declare none of these are UTF-8.
+static Text_Encoding detect_encoding(string head, string content_type);
+static void begin_transcode(UTF8_Transcoder *transcoder, string head, string content_type);
+
+// NOTE(ariel) Write valid UTF-8 for `source` to `destination`, which must hold
+// MAX_TRANSCODED_SIZE(source.len) bytes, and return the number of bytes written.
+// Invalid sequences become U+FFFD. Pass `is_last` with the final piece to flush
+// a character left incomplete at the end of the document.
+static s32 transcode_to_utf8(UTF8_Transcoder *transcoder, char *destination, string source, b32 is_last);
+static string transcode_document_to_utf8(arena *Arena, string source, string content_type);
+
+// NOTE(ariel) Point `view` at the document past its byte order mark, without
+// copying it, and return true if the document is already valid UTF-8.
+// Otherwise the document needs transcode_document_to_utf8().
+static b32 view_utf8_document(string source, string *view);
+
+#endif
@@ -0,0 +1,721 @@
+static void
+GrowResponse(curl_response *Response, u64 ByteCount)
+{
+	enum { RESPONSE_COMMIT_SIZE = MB(1) };
+	u64 CommittedByteCount = (ByteCount + RESPONSE_COMMIT_SIZE - 1) / RESPONSE_COMMIT_SIZE * RESPONSE_COMMIT_SIZE;
+	CommittedByteCount = MIN(CommittedByteCount, Response->ReservedByteCount);
+	CommittedByteCount = MAX(CommittedByteCount, Response->CommittedByteCount);
+	AssertAlways(ByteCount <= CommittedByteCount);
+
+	if(!Response->Spilled && ByteCount > (u64)Response->SpillThreshold)
+	{
+		s32 File = SpillVirtualMemoryToFile(Response->Buffer,
+			Response->ReservedByteCount, (u64)Response->Data.len, CommittedByteCount);
+		Response->Spilled = File >= 0;
+		Response->SpillFile = File;
+		Response->CommittedByteCount = Response->Spilled ? CommittedByteCount : Response->CommittedByteCount;
+	}
+
+	if(CommittedByteCount > Response->CommittedByteCount)
+	{
+		if(Response->Spilled)
+		{
+			GrowSpilledVirtualMemory(Response->SpillFile, CommittedByteCount);
+		}
+		else
+		{
+			CommitVirtualMemory(Response->Buffer, CommittedByteCount);
+		}
+		Response->CommittedByteCount = CommittedByteCount;
+	}
+}
+
+static u64
+MixBodyHash(u64 State, u64 Word)
+{
+	State = (State ^ Word) * 0xff51afd7ed558ccdull;
+	State ^= State >> 32;
+	return State;
+}
+
+static void
+UpdateBodyHash(curl_response *Response, u8 *Bytes, u64 ByteCount)
+{
+	// NOTE(ariel) Hash eight bytes at a time. Pieces of the body split at
+	// arbitrary offsets, so carry bytes that don't fill a word over to the next
+	// piece to hash the same body the same way however it arrives.
+	u64 State = Response->BodyHashState;
+	u64 Tail = Response->BodyHashTail;
+	s32 TailByteCount = Response->BodyHashTailByteCount;
+	u64 Index = 0;
+	for(; Index < ByteCount && TailByteCount > 0 && TailByteCount < 8; Index += 1)
+	{
+		Tail |= (u64)Bytes[Index] << (8*TailByteCount);
+		TailByteCount += 1;
+	}
+	if(TailByteCount == 8)
+	{
+		State = MixBodyHash(State, Tail);
+		Tail = 0;
+		TailByteCount = 0;
+	}
+	for(; Index + 8 <= ByteCount; Index += 8)
+	{
+		u64 Word = 0;
+		memcpy(&Word, Bytes + Index, sizeof(Word));
+		State = MixBodyHash(State, Word);
+	}
+	for(; Index < ByteCount; Index += 1)
+	{
+		Tail |= (u64)Bytes[Index] << (8*TailByteCount);
+		TailByteCount += 1;
+	}
+	Response->BodyHashState = State;
+	Response->BodyHashTail = Tail;
+	Response->BodyHashTailByteCount = TailByteCount;
+}
+
+static u64
+FinishBodyHash(curl_response *Response)
+{
+	// NOTE(ariel) Fold in the length so that trailing zeros count, then finish
+	// with SplitMix64's finalizer so that every bit of input reaches every bit
+	// of output.
+	u64 Hash = MixBodyHash(Response->BodyHashState, Response->BodyHashTail);
+	Hash ^= (u64)Response->DecompressedByteCount;
+	Hash = (Hash ^ (Hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+	Hash = (Hash ^ (Hash >> 27)) * 0x94d049bb133111ebull;
+	Hash ^= Hash >> 31;
+	return Hash;
+}
+
+static u64
+HashBody(string Body)
+{
+	curl_response Response = { .DecompressedByteCount = Body.len };
+	UpdateBodyHash(&Response, (u8 *)Body.str, Body.len);
+	u64 Hash = FinishBodyHash(&Response);
+	return Hash;
+}
+
+static void
+TranscodeResponse(curl_response *Response, string Bytes, b32 IsLast)
+{
+	// NOTE(ariel) Transcode the response to UTF-8 as it arrives so that the
+	// parser, the database, and the renderer only ever see valid UTF-8. Each
+	// byte transcodes to at most three, so the response never outgrows its
+	// reservation.
+	GrowResponse(Response, (u64)Response->Data.len + MAX_TRANSCODED_SIZE((u64)Bytes.len));
+	Response->Data.len += transcode_to_utf8(&Response->Transcoder, Response->Data.str + Response->Data.len, Bytes, IsLast);
+}
+
+static void
+BeginTranscodingResponse(curl_response *Response)
+{
+	// NOTE(ariel) The head of the response holds its byte order mark or XML
+	// declaration, which along with the Content-Type header determine its
+	// encoding.
+	char *ContentType = 0;
+	curl_easy_getinfo(Response->CurlHandle, CURLINFO_CONTENT_TYPE, &ContentType);
+	string ContentTypeString = { .str = ContentType, .len = ContentType ? (s32)strlen(ContentType) : 0 };
+	string Head = { .str = (char *)Response->Head, .len = Response->HeadByteCount };
+	begin_transcode(&Response->Transcoder, Head, ContentTypeString);
+	Response->TranscodeBegan = true;
+	TranscodeResponse(Response, Head, false);
+}
+
+static size_t
+StoreResponseFromCurl(char *Data, size_t Size, size_t Count, void *CustomUserData)
+{
+	size_t TotalBytes = Size * Count;
+
+	curl_response *Response = CustomUserData;
+	Response->DecompressedByteCount += (s64)TotalBytes;
+	if(Response->DecompressedByteCount > Response->DecompressedSizeLimit)
+	{
+		// NOTE(ariel) libcurl aborts the transfer when this function handles fewer
+		// bytes than it received.
+		Response->ExceededSizeLimit = true;
+		return 0;
+	}
+
+	if(Response->Recording)
+	{
+		fwrite(Data, 1, TotalBytes, Response->Recording);
+	}
+	UpdateBodyHash(Response, (u8 *)Data, TotalBytes);
+
+	assert(TotalBytes <= INT32_MAX);
+	string Bytes = { .str = Data, .len = (s32)TotalBytes };
+	if(!Response->Buffer)
+	{
+		Response->ReservedByteCount = MAX_TRANSCODED_SIZE((u64)Response->DecompressedSizeLimit);
+		Response->Buffer = ReserveVirtualMemory(Response->ReservedByteCount);
+		Response->Data.str = (char *)Response->Buffer;
+	}
+
+	if(!Response->TranscodeBegan)
+	{
+		// NOTE(ariel) Servers may send the body in pieces as small as a byte, so
+		// collect the head across pieces.
+		s32 HeadByteCount = MIN(Bytes.len, ENCODING_HEAD_SIZE - Response->HeadByteCount);
+		memcpy(Response->Head + Response->HeadByteCount, Bytes.str, HeadByteCount);
+		Response->HeadByteCount += HeadByteCount;
+		Bytes = string_suffix(Bytes, HeadByteCount);
+		if(Response->HeadByteCount == ENCODING_HEAD_SIZE)
+		{
+			BeginTranscodingResponse(Response);
+		}
+	}
+
+	if(Response->TranscodeBegan && Bytes.len)
+	{
+		TranscodeResponse(Response, Bytes, false);
+	}
+
+	return TotalBytes;
+}
+
+static b32
+MatchHeaderName(string Name, char *LowercaseName)
+{
+	b32 Match = Name.len == (s32)strlen(LowercaseName);
+	for(s32 Index = 0; Match && Index < Name.len; Index += 1)
+	{
+		Match = tolower((unsigned char)Name.str[Index]) == LowercaseName[Index];
+	}
+	return Match;
+}
+
+static size_t
+StoreHeaderFromCurl(char *Data, size_t Size, size_t Count, void *CustomUserData)
+{
+	size_t TotalBytes = Size * Count;
+
+	curl_response *Response = CustomUserData;
+	string Line = string_trim_spaces((string){ .str = Data, .len = (s32)TotalBytes });
+	string StatusLinePrefix = string_literal("HTTP/");
+	if(string_match(string_prefix(Line, StatusLinePrefix.len), StatusLinePrefix))
+	{
+		// NOTE(ariel) Headers of an interim response, like 100 Continue, don't
+		// describe the final one.
+		Response->ETag = (string){0};
+		Response->LastModified = (string){0};
+		if(Response->Recording)
+		{
+			fflush(Response->Recording);
+			s32 Status = ftruncate(fileno(Response->Recording), 0); (void)Status;
+			rewind(Response->Recording);
+		}
+	}
+	else
+	{
+		s32 Colon = string_find_ch(Line, ':');
+		if(Colon > 0 && Colon + 1 < Line.len)
+		{
+			string Name = string_prefix(Line, Colon);
+			string Value = string_trim_spaces(string_suffix(Line, Colon + 1));
+			if(MatchHeaderName(Name, "etag"))
+			{
+				Response->ETag = string_duplicate(Response->Arena, Value);
+			}
+			else if(MatchHeaderName(Name, "last-modified"))
+			{
+				Response->LastModified = string_duplicate(Response->Arena, Value);
+			}
+		}
+	}
+
+	if(Response->Recording)
+	{
+		fwrite(Data, 1, TotalBytes, Response->Recording);
+	}
+
+	return TotalBytes;
+}
+
+static void
+PrepareFetch(curl_response *Response, char *URL)
+{
+	if(!Response->DecompressedSizeLimit)
+	{
+		Response->DecompressedSizeLimit = MAX_DECOMPRESSED_RESPONSE_SIZE;
+	}
+	if(!Response->SpillThreshold)
+	{
+		Response->SpillThreshold = SPILL_RESPONSE_SIZE;
+	}
+	AssertAlways(MAX_TRANSCODED_SIZE(Response->DecompressedSizeLimit) <= INT32_MAX);
+
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_URL, URL);
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_WRITEFUNCTION, StoreResponseFromCurl);
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_WRITEDATA, Response);
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_HEADERFUNCTION, StoreHeaderFromCurl);
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_HEADERDATA, Response);
+
+	// NOTE(ariel) An empty string offers every encoding this build of libcurl
+	// decodes, usually gzip and deflate and sometimes brotli and zstd. libcurl
+	// decompresses the response as it arrives and hands StoreResponseFromCurl()
+	// the decompressed bytes.
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_ACCEPT_ENCODING, "");
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_MAXFILESIZE_LARGE, (curl_off_t)Response->DecompressedSizeLimit);
+}
+
+static void
+FinishFetch(curl_response *Response)
+{
+	curl_off_t CompressedByteCount = 0;
+	curl_easy_getinfo(Response->CurlHandle, CURLINFO_SIZE_DOWNLOAD_T, &CompressedByteCount);
+	Response->CompressedByteCount = CompressedByteCount;
+	Response->BodyHash = FinishBodyHash(Response);
+
+	if(Response->Buffer && !Response->TranscodeBegan)
+	{
+		// NOTE(ariel) The whole response fit in its head.
+		BeginTranscodingResponse(Response);
+	}
+	if(Response->Transcoder.pending_count)
+	{
+		// NOTE(ariel) The response ended partway through a character.
+		TranscodeResponse(Response, (string){0}, true);
+	}
+}
+
+static void
+ReleaseResponse(curl_response *Response)
+{
+	if(Response->Buffer)
+	{
+		ReleaseVirtualMemory(Response->Buffer, Response->ReservedByteCount);
+	}
+	if(Response->Spilled)
+	{
+		CloseSpillFile(Response->SpillFile);
+	}
+	Response->Buffer = 0;
+	Response->ReservedByteCount = 0;
+	Response->CommittedByteCount = 0;
+	Response->Spilled = false;
+	Response->Data = (string){0};
+	Response->TranscodeBegan = false;
+	Response->HeadByteCount = 0;
+}
+
+static struct curl_slist *
+AppendConditionalHeaders(struct curl_slist *Headers, fetch_validators Validators)
+{
+	char Header[1024];
+	if(Validators.ETag.len)
+	{
+		snprintf(Header, sizeof(Header), "If-None-Match: %.*s", Validators.ETag.len, Validators.ETag.str);
+		Headers = curl_slist_append(Headers, Header);
+	}
+	if(Validators.LastModified.len)
+	{
+		snprintf(Header, sizeof(Header), "If-Modified-Since: %.*s", Validators.LastModified.len, Validators.LastModified.str);
+		Headers = curl_slist_append(Headers, Header);
+	}
+	return Headers;
+}
+
+static void
+FormatRecordingName(char *Name, s32 NameSize, char *URL)
+{
+	// NOTE(ariel) Hash URLs with 64-bit FNV-1a so that recordings get short
+	// names safe for any file system.
+	u64 Hash = 14695981039346656037ull;
+	for(char *Character = URL; *Character; Character += 1)
+	{
+		Hash = (Hash ^ (u8)*Character) * 1099511628211ull;
+	}
+	snprintf(Name, NameSize, "%016llx", (unsigned long long)Hash);
+}
+
+static u64
+HashURLHost(char *URL)
+{
+	// NOTE(ariel) Hash the host and port of the URL, without any user info,
+	// ignoring case.
+	char *Host = strstr(URL, "://");
+	Host = Host ? Host + 3 : URL;
+	char *HostEnd = Host + strcspn(Host, "/?#");
+	for(char *Character = Host; Character < HostEnd; Character += 1)
+	{
+		if(*Character == '@')
+		{
+			Host = Character + 1;
+		}
+	}
+
+	u64 Hash = 14695981039346656037ull;
+	for(char *Character = Host; Character < HostEnd; Character += 1)
+	{
+		char Lowercase = *Character >= 'A' && *Character <= 'Z' ? *Character + ('a' - 'A') : *Character;
+		Hash = (Hash ^ (u8)Lowercase) * 1099511628211ull;
+	}
+	return Hash;
+}
+
+static b32
+HostHasRoom(fetch_engine *Engine, u64 HostHash)
+{
+	s32 TransferCount = 0;
+	for(s32 Index = 0; Index < Engine->MaxTransferCount; Index += 1)
+	{
+		fetch_transfer *Transfer = &Engine->Transfers[Index];
+		TransferCount += Transfer->InFlight && Transfer->HostHash == HostHash;
+	}
+	return TransferCount < Engine->MaxTransfersPerHost;
+}
+
+static s32
+PickRequestQueue(fetch_engine *Engine, fetch_priority LeastUrgentPriority, s32 *PickedOffset)
+{
+	// NOTE(ariel) Give the oldest request of each lane to a host with room for
+	// it a deadline that lies one aging period later for each step it sits below
+	// the most urgent lane, and pick the lane whose deadline comes first.
+	s32 PickedPriority = -1;
+	s64 EarliestDeadline = INT64_MAX;
+	for(s32 Priority = 0; Priority <= LeastUrgentPriority; Priority += 1)
+	{
+		fetch_request_queue *Queue = &Engine->Queues[Priority];
+		s32 LookaheadCount = MIN(Queue->RequestCount, FETCH_HOST_LOOKAHEAD);
+		for(s32 Offset = 0; Offset < LookaheadCount; Offset += 1)
+		{
+			fetch_request *Request = &Queue->Requests[(Queue->NextRequestIndex + Offset) % Queue->MaxRequestCount];
+			if(HostHasRoom(Engine, Request->HostHash))
+			{
+				s64 Deadline = Request->QueuedTime + Priority*FETCH_AGING_SECONDS;
+				if(Deadline < EarliestDeadline)
+				{
+					EarliestDeadline = Deadline;
+					PickedPriority = Priority;
+					*PickedOffset = Offset;
+				}
+				break;
+			}
+		}
+	}
+	return PickedPriority;
+}
+
+static fetch_request
+RemoveRequest(fetch_request_queue *Queue, s32 Offset)
+{
+	// NOTE(ariel) Close the gap the request leaves behind. Requests usually
+	// leave from the front of the lane, where there's no gap to close.
+	s32 RequestIndex = (Queue->NextRequestIndex + Offset) % Queue->MaxRequestCount;
+	fetch_request Request = Queue->Requests[RequestIndex];
+	for(; Offset > 0; Offset -= 1)
+	{
+		s32 PreviousRequestIndex = (Queue->NextRequestIndex + Offset - 1) % Queue->MaxRequestCount;
+		Queue->Requests[RequestIndex] = Queue->Requests[PreviousRequestIndex];
+		RequestIndex = PreviousRequestIndex;
+	}
+	Queue->NextRequestIndex = (Queue->NextRequestIndex + 1) % Queue->MaxRequestCount;
+	Queue->RequestCount -= 1;
+	return Request;
+}
+
+static void
+PushRequest(fetch_request_queue *Queue, fetch_request Request)
+{
+	if(Queue->RequestCount == Queue->MaxRequestCount)
+	{
+		// NOTE(ariel) The program may add feeds past the count it sized the engine
+		// for, so grow the lane rather than refuse requests. Unwrap the requests
+		// into the new ring in order.
+		s32 MaxRequestCount = 2*Queue->MaxRequestCount;
+		fetch_request *Requests = calloc(MaxRequestCount, sizeof(fetch_request));
+		AssertAlways(Requests);
+		for(s32 Offset = 0; Offset < Queue->RequestCount; Offset += 1)
+		{
+			Requests[Offset] = Queue->Requests[(Queue->NextRequestIndex + Offset) % Queue->MaxRequestCount];
+		}
+		free(Queue->Requests);
+		Queue->Requests = Requests;
+		Queue->MaxRequestCount = MaxRequestCount;
+		Queue->NextRequestIndex = 0;
+	}
+
+	s32 RequestIndex = (Queue->NextRequestIndex + Queue->RequestCount) % Queue->MaxRequestCount;
+	Queue->Requests[RequestIndex] = Request;
+	Queue->RequestCount += 1;
+}
+
+static void
+StartTransfer(fetch_engine *Engine, fetch_transfer *Transfer, fetch_request Request, fetch_priority Priority)
+{
+	curl_easy_reset(Transfer->CurlHandle);
+	Transfer->Response = (curl_response){ .CurlHandle = Transfer->CurlHandle, .Arena = &Transfer->Arena };
+	Transfer->Result = CURLE_OK;
+	Transfer->HTTPResponseCode = 0;
+	Transfer->UserData = Request.UserData;
+	Transfer->Priority = Priority;
+	Transfer->HostHash = Request.HostHash;
+	Transfer->InFlight = true;
+
+	// NOTE(ariel) libcurl reads the list of headers throughout the transfer, so
+	// free the list of the previous transfer only once its handle resets.
+	curl_slist_free_all(Transfer->Headers);
+	Transfer->Headers = Request.Headers;
+
+	char *URL = Request.URL;
+	char ReplayURL[1024] = {0};
+	char RecordingName[32] = {0};
+	FormatRecordingName(RecordingName, sizeof(RecordingName), Request.URL);
+	if(Engine->ReplayAddress)
+	{
+		snprintf(ReplayURL, sizeof(ReplayURL), "%s/%s", Engine->ReplayAddress, RecordingName);
+		URL = ReplayURL;
+	}
+	if(Engine->RecordDirectory)
+	{
+		snprintf(Transfer->RecordingPath, sizeof(Transfer->RecordingPath), "%s/%s", Engine->RecordDirectory, RecordingName);
+		Transfer->Response.Recording = fopen(Transfer->RecordingPath, "wb");
+	}
+
+	PrepareFetch(&Transfer->Response, URL);
+	curl_easy_setopt(Transfer->CurlHandle, CURLOPT_HTTPHEADER, Transfer->Headers);
+	curl_easy_setopt(Transfer->CurlHandle, CURLOPT_PRIVATE, Transfer);
+	curl_easy_setopt(Transfer->CurlHandle, CURLOPT_SHARE, Engine->ShareHandle);
+	curl_easy_setopt(Transfer->CurlHandle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(Transfer->CurlHandle, CURLOPT_PIPEWAIT, 1L);
+	curl_multi_add_handle(Engine->MultiHandle, Transfer->CurlHandle);
+	free(Request.URL);
+}
+
+static void *
+FetchThreadProcess(void *Argument)
+{
+	fetch_engine *Engine = Argument;
+
+	for(;;)
+	{
+		// NOTE(ariel) Start as many queued requests as there are free transfers.
+		// The rest wait for a transfer to free up.
+		b32 ShouldStop = false;
+		pthread_mutex_lock(&Engine->Mutex);
+		{
+			s32 ReservedTransferCount = Engine->MaxTransferCount > 1;
+			while(Engine->FirstFreeTransfer)
+			{
+				fetch_priority LeastUrgentPriority = Engine->FreeTransferCount > ReservedTransferCount
+					? FETCH_PRIORITY_COUNT - 1
+					: FETCH_PRIORITY_INTERACTIVE;
+				s32 Offset = 0;
+				s32 Priority = PickRequestQueue(Engine, LeastUrgentPriority, &Offset);
+				if(Priority < 0)
+				{
+					break;
+				}
+
+				fetch_transfer *Transfer = Engine->FirstFreeTransfer;
+				Engine->FirstFreeTransfer = Transfer->NextFree;
+				Engine->FreeTransferCount -= 1;
+				Transfer->NextFree = 0;
+
+				fetch_request Request = RemoveRequest(&Engine->Queues[Priority], Offset);
+
+				StartTransfer(Engine, Transfer, Request, (fetch_priority)Priority);
+			}
+			ShouldStop = Engine->ShouldStop;
+		}
+		pthread_mutex_unlock(&Engine->Mutex);
+		if(ShouldStop)
+		{
+			break;
+		}
+
+		int RunningTransferCount = 0;
+		curl_multi_perform(Engine->MultiHandle, &RunningTransferCount);
+
+		CURLMsg *Message = 0;
+		int RemainingMessageCount = 0;
+		while((Message = curl_multi_info_read(Engine->MultiHandle, &RemainingMessageCount)))
+		{
+			if(Message->msg == CURLMSG_DONE)
+			{
+				fetch_transfer *Transfer = 0;
+				curl_easy_getinfo(Message->easy_handle, CURLINFO_PRIVATE, &Transfer);
+				curl_easy_getinfo(Message->easy_handle, CURLINFO_RESPONSE_CODE, &Transfer->HTTPResponseCode);
+				Transfer->Result = Message->data.result;
+				Transfer->InFlight = false;
+				FinishFetch(&Transfer->Response);
+				if(Transfer->Response.Recording)
+				{
+					// NOTE(ariel) Keep only recordings of responses that arrived in full.
+					fclose(Transfer->Response.Recording);
+					Transfer->Response.Recording = 0;
+					if(Transfer->Result != CURLE_OK)
+					{
+						remove(Transfer->RecordingPath);
+					}
+				}
+				curl_multi_remove_handle(Engine->MultiHandle, Message->easy_handle);
+				Engine->Complete(Transfer);
+			}
+		}
+
+		// NOTE(ariel) Sleep until some transfer makes progress, or until another
+		// thread queues a request or releases a transfer.
+		curl_multi_poll(Engine->MultiHandle, 0, 0, 1000, 0);
+	}
+
+	return 0;
+}
+
+static void
+StartFetchEngine(fetch_engine *Engine, arena *Arena,
+	s32 MaxTransferCount, s32 MaxTransfersPerHost, s32 MaxRequestCount, fetch_completion Complete)
+{
+	s32 Status = 0; (void)Status;
+
+	Engine->MultiHandle = curl_multi_init(); AssertAlways(Engine->MultiHandle);
+	curl_multi_setopt(Engine->MultiHandle, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+	curl_multi_setopt(Engine->MultiHandle, CURLMOPT_MAX_HOST_CONNECTIONS, (long)MaxTransfersPerHost);
+	Engine->MaxTransfersPerHost = MaxTransfersPerHost;
+
+	// NOTE(ariel) Only the engine's thread touches the handles, so the share
+	// handle needs no locks.
+	Engine->ShareHandle = curl_share_init(); AssertAlways(Engine->ShareHandle);
+	curl_share_setopt(Engine->ShareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(Engine->ShareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+	Engine->Complete = Complete;
+	if(Engine->RecordDirectory)
+	{
+		// NOTE(ariel) Leave room in each path for a separator and the name.
+		AssertAlways(strlen(Engine->RecordDirectory) + 18 < sizeof(Engine->Transfers->RecordingPath));
+	}
+	Status = pthread_mutex_init(&Engine->Mutex, 0);
+	Assert(Status == 0);
+
+	AssertAlways(MaxRequestCount > 0);
+	for(s32 Priority = 0; Priority < FETCH_PRIORITY_COUNT; Priority += 1)
+	{
+		fetch_request_queue *Queue = &Engine->Queues[Priority];
+		Queue->MaxRequestCount = MaxRequestCount;
+		Queue->Requests = calloc(MaxRequestCount, sizeof(fetch_request));
+		AssertAlways(Queue->Requests);
+	}
+
+	Engine->MaxTransferCount = MaxTransferCount;
+	Engine->Transfers = PushArrayToArena(Arena, fetch_transfer, MaxTransferCount);
+	for(s32 Index = MaxTransferCount - 1; Index >= 0; Index -= 1)
+	{
+		fetch_transfer *Transfer = &Engine->Transfers[Index];
+		Transfer->CurlHandle = curl_easy_init(); AssertAlways(Transfer->CurlHandle);
+		InitializeArena(&Transfer->Arena);
+		Transfer->NextFree = Engine->FirstFreeTransfer;
+		Engine->FirstFreeTransfer = Transfer;
+	}
+	Engine->FreeTransferCount = MaxTransferCount;
+
+	Status = pthread_create(&Engine->Thread, 0, FetchThreadProcess, Engine);
+	Assert(Status == 0);
+}
+
+static void
+StopFetchEngine(fetch_engine *Engine)
+{
+	pthread_mutex_lock(&Engine->Mutex);
+	{
+		Engine->ShouldStop = true;
+	}
+	pthread_mutex_unlock(&Engine->Mutex);
+	curl_multi_wakeup(Engine->MultiHandle);
+	pthread_join(Engine->Thread, 0);
+
+	for(s32 Index = 0; Index < Engine->MaxTransferCount; Index += 1)
+	{
+		fetch_transfer *Transfer = &Engine->Transfers[Index];
+		curl_multi_remove_handle(Engine->MultiHandle, Transfer->CurlHandle);
+		curl_easy_cleanup(Transfer->CurlHandle);
+		curl_slist_free_all(Transfer->Headers);
+		if(Transfer->Response.Recording)
+		{
+			fclose(Transfer->Response.Recording);
+			remove(Transfer->RecordingPath);
+		}
+		ReleaseResponse(&Transfer->Response);
+	}
+	for(s32 Priority = 0; Priority < FETCH_PRIORITY_COUNT; Priority += 1)
+	{
+		fetch_request_queue *Queue = &Engine->Queues[Priority];
+		for(s32 Offset = 0; Offset < Queue->RequestCount; Offset += 1)
+		{
+			fetch_request *Request = &Queue->Requests[(Queue->NextRequestIndex + Offset) % Queue->MaxRequestCount];
+			free(Request->URL);
+			curl_slist_free_all(Request->Headers);
+		}
+		free(Queue->Requests);
+		*Queue = (fetch_request_queue){0};
+	}
+	curl_multi_cleanup(Engine->MultiHandle);
+	curl_share_cleanup(Engine->ShareHandle);
+}
+
+static void
+QueueFetch(fetch_engine *Engine, string URL, fetch_validators Validators, fetch_priority Priority, void *UserData)
+{
+	Assert(Priority < FETCH_PRIORITY_COUNT);
+
+	// NOTE(ariel) libcurl needs a null-terminated URL. It copies the URL when
+	// the transfer starts, so the engine frees its own copy then.
+	fetch_request Request = {0};
+	Request.URL = calloc(URL.len + 1, sizeof(char));
+	memcpy(Request.URL, URL.str, URL.len);
+	Request.Headers = AppendConditionalHeaders(0, Validators);
+	Request.UserData = UserData;
+	Request.QueuedTime = time(0);
+	Request.HostHash = HashURLHost(Request.URL);
+
+	pthread_mutex_lock(&Engine->Mutex);
+	{
+		PushRequest(&Engine->Queues[Priority], Request);
+	}
+	pthread_mutex_unlock(&Engine->Mutex);
+	curl_multi_wakeup(Engine->MultiHandle);
+}
+
+static b32
+PromoteFetch(fetch_engine *Engine, string URL, fetch_priority Priority)
+{
+	b32 Promoted = false;
+	pthread_mutex_lock(&Engine->Mutex);
+	for(s32 LessUrgentPriority = Priority + 1; !Promoted && LessUrgentPriority < FETCH_PRIORITY_COUNT; LessUrgentPriority += 1)
+	{
+		fetch_request_queue *Queue = &Engine->Queues[LessUrgentPriority];
+		for(s32 Offset = 0; !Promoted && Offset < Queue->RequestCount; Offset += 1)
+		{
+			char *RequestURL = Queue->Requests[(Queue->NextRequestIndex + Offset) % Queue->MaxRequestCount].URL;
+			if(strncmp(RequestURL, URL.str, URL.len) == 0 && RequestURL[URL.len] == 0)
+			{
+				PushRequest(&Engine->Queues[Priority], RemoveRequest(Queue, Offset));
+				Promoted = true;
+			}
+		}
+	}
+	pthread_mutex_unlock(&Engine->Mutex);
+	if(Promoted)
+	{
+		curl_multi_wakeup(Engine->MultiHandle);
+	}
+	return Promoted;
+}
+
+static void
+ReleaseTransfer(fetch_engine *Engine, fetch_transfer *Transfer)
+{
+	ReleaseResponse(&Transfer->Response);
+	ClearArena(&Transfer->Arena);
+	pthread_mutex_lock(&Engine->Mutex);
+	{
+		Transfer->NextFree = Engine->FirstFreeTransfer;
+		Engine->FirstFreeTransfer = Transfer;
+		Engine->FreeTransferCount += 1;
+	}
+	pthread_mutex_unlock(&Engine->Mutex);
+	curl_multi_wakeup(Engine->MultiHandle);
+}
@@ -0,0 +1,204 @@
+#ifndef FETCH_H
+#define FETCH_H
+
+// NOTE(ariel) Stop decompressing a response once it grows past this size. No
+// honest feed comes close, but a small compressed response may claim to
+// expand without bound.
+#define MAX_DECOMPRESSED_RESPONSE_SIZE MB(128)
+
+// NOTE(ariel) Move responses that grow past this size onto a temporary file.
+#define SPILL_RESPONSE_SIZE MB(16)
+
+// NOTE(ariel) Detect the encoding of a response from at least this many bytes
+// of it, enough for any byte order mark and XML declaration.
+#define ENCODING_HEAD_SIZE 512
+
+typedef struct curl_response curl_response;
+struct curl_response
+{
+	CURL *CurlHandle;
+	arena *Arena;
+	string Data;
+	UTF8_Transcoder Transcoder;
+
+	// NOTE(ariel) The response holds back the first bytes of its body until it
+	// has enough of them to find the byte order mark or XML declaration that
+	// determines its encoding, or until it ends.
+	b32 TranscodeBegan;
+	s32 HeadByteCount;
+	u8 Head[ENCODING_HEAD_SIZE];
+
+	// NOTE(ariel) The response reserves enough address space for the largest
+	// response it accepts, so it grows in place and its address never changes.
+	// Past `SpillThreshold` bytes it moves onto
+	// a temporary file mapped at the same address.
+	u8 *Buffer;
+	u64 ReservedByteCount;
+	u64 CommittedByteCount;
+	s64 SpillThreshold;
+	b32 Spilled;
+	s32 SpillFile;
+
+	s64 DecompressedSizeLimit;
+	b32 ExceededSizeLimit;
+	s64 CompressedByteCount;
+	s64 DecompressedByteCount;
+
+	// NOTE(ariel) Validators of the response, if the server sent any, to make
+	// the next request for the same resource conditional.
+	string ETag;
+	string LastModified;
+
+	// NOTE(ariel) The response hashes its body as it arrives, before it
+	// transcodes it, for servers that ignore conditional requests or regenerate
+	// the same feed. FinishFetch() sets `BodyHash`.
+	u64 BodyHashState;
+	u64 BodyHashTail;
+	s32 BodyHashTailByteCount;
+	u64 BodyHash;
+
+	// NOTE(ariel) If set, the response writes every header line and every byte
+	// of its body to this file as they arrive. The body is decompressed but not
+	// transcoded, and the file only keeps the final response of any interim ones.
+	FILE *Recording;
+};
+
+typedef struct fetch_validators fetch_validators;
+struct fetch_validators
+{
+	string ETag;
+	string LastModified;
+};
+
+// NOTE(ariel) Set up the response's handle to download the URL. The caller
+// sets `CurlHandle`, `Arena`, and optionally the limits beforehand,
+// calls curl_easy_perform(), and then FinishFetch(). The arena only holds
+// headers. The response holds its body until ReleaseResponse().
+static void PrepareFetch(curl_response *Response, char *URL);
+static void FinishFetch(curl_response *Response);
+static void ReleaseResponse(curl_response *Response);
+
+// NOTE(ariel) Hash a whole body the same way a response hashes its body as it
+// arrives, for bodies that come from elsewhere.
+static u64 HashBody(string Body);
+
+// NOTE(ariel) Ask the server to respond 304 Not Modified rather than send the
+// resource again if it still matches these validators.
+static struct curl_slist *AppendConditionalHeaders(struct curl_slist *Headers, fetch_validators Validators);
+
+// NOTE(ariel) The engine starts queued requests from the most urgent lane
+// first, except that a request ages one lane more urgent every
+// `FETCH_AGING_SECONDS` it waits, so bulk refreshes still make progress while
+// the user reloads feeds.
+typedef u8 fetch_priority;
+enum
+{
+	FETCH_PRIORITY_INTERACTIVE,
+	FETCH_PRIORITY_VISIBLE,
+	FETCH_PRIORITY_BACKGROUND,
+	FETCH_PRIORITY_COUNT,
+};
+
+#define FETCH_AGING_SECONDS 5
+
+// NOTE(ariel) The engine looks this many requests into each lane for one to a
+// host with room for another request.
+#define FETCH_HOST_LOOKAHEAD 16
+
+typedef struct fetch_transfer fetch_transfer;
+struct fetch_transfer
+{
+	fetch_transfer *NextFree;
+	CURL *CurlHandle;
+	struct curl_slist *Headers;
+	arena Arena;
+	curl_response Response;
+	CURLcode Result;
+	long HTTPResponseCode;
+	fetch_priority Priority;
+	void *UserData;
+	char RecordingPath[256];
+
+	// NOTE(ariel) Only the engine's thread reads or writes these.
+	u64 HostHash;
+	b32 InFlight;
+};
+
+typedef struct fetch_request fetch_request;
+struct fetch_request
+{
+	char *URL;
+	struct curl_slist *Headers;
+	void *UserData;
+	s64 QueuedTime;
+	u64 HostHash;
+};
+
+typedef struct fetch_request_queue fetch_request_queue;
+struct fetch_request_queue
+{
+	fetch_request *Requests;
+	s32 MaxRequestCount;
+	s32 RequestCount;
+	s32 NextRequestIndex;
+};
+
+// NOTE(ariel) The fetch engine calls this procedure on its own thread once a
+// transfer finishes, successfully or not. The transfer and its response
+// remain valid until the program passes it to ReleaseTransfer().
+typedef void (*fetch_completion)(fetch_transfer *Transfer);
+
+// NOTE(ariel) One thread drives every transfer through a multi handle, so
+// the number of transfers in flight doesn't depend on the number of threads.
+// Any thread may queue requests and release transfers. Transfers share the
+// multi handle's cache of connections and the share handle's caches of DNS
+// lookups and TLS sessions, so a transfer to a host another transfer visited
+// recently skips the handshakes.
+typedef struct fetch_engine fetch_engine;
+struct fetch_engine
+{
+	CURLM *MultiHandle;
+	CURLSH *ShareHandle;
+	pthread_t Thread;
+	fetch_completion Complete;
+
+	pthread_mutex_t Mutex;
+	b32 ShouldStop;
+	fetch_transfer *FirstFreeTransfer;
+	s32 FreeTransferCount;
+	fetch_request_queue Queues[FETCH_PRIORITY_COUNT];
+
+	fetch_transfer *Transfers;
+	s32 MaxTransferCount;
+	s32 MaxTransfersPerHost;
+
+	// NOTE(ariel) Set either before StartFetchEngine() to benchmark the program
+	// offline. The engine records each complete response to a file in
+	// `RecordDirectory` named after the hash of its URL, and asks
+	// `ReplayAddress` for the recording of a URL rather than the URL itself.
+	// tests/replay_server.py serves recordings.
+	char *RecordDirectory;
+	char *ReplayAddress;
+};
+
+// NOTE(ariel) The engine keeps at most `MaxTransfersPerHost` requests in flight
+// to any one host, whether they share one HTTP/2 connection or each hold an
+// HTTP/1.1 connection of their own. A request to a host at its cap waits in its
+// lane while requests behind it to other hosts start. Each lane starts with
+// room for `MaxRequestCount` requests and doubles whenever it fills. Unless the
+// engine only has one transfer, it keeps the last free transfer for
+// interactive requests, so they start right away even while other requests
+// occupy every other transfer.
+static void StartFetchEngine(fetch_engine *Engine, arena *Arena,
+	s32 MaxTransferCount, s32 MaxTransfersPerHost, s32 MaxRequestCount, fetch_completion Complete);
+static void StopFetchEngine(fetch_engine *Engine);
+
+// NOTE(ariel) The engine copies the URL and validators before QueueFetch()
+// returns. PromoteFetch() moves a queued request for the URL to a more urgent
+// lane and returns false if it finds none, e.g. because its transfer started.
+// The transfer of a request carries the priority it started with.
+static void QueueFetch(fetch_engine *Engine, string URL, fetch_validators Validators, fetch_priority Priority, void *UserData);
+static b32 PromoteFetch(fetch_engine *Engine, string URL, fetch_priority Priority);
+static void ReleaseTransfer(fetch_engine *Engine, fetch_transfer *Transfer);
+
+#endif
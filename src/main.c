@@ -1,9 +1,14 @@
+#if defined(__linux__)
+#include <dirent.h>
+#endif
 #include <errno.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdatomic.h>
+#include <time.h>
 
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <unistd.h>
 
@@ -20,8 +25,11 @@
 #include "arena.h"
 #include "date_time.h"
 #include "str.h"
+#include "encoding.h"
 #include "rss.h"
+#include "fetch.h"
 #include "db.h"
+#include "schedule.h"
 #include "err.h"
 #include "font.h"
 #include "linalg.h"
@@ -29,11 +37,14 @@
 #include "pool.h"
 #include "ui.h"
 #include "renderer.h"
-#include "string_table.h"
 #include "multithreading.h"
 
+// NOTE(ariel) Only Linux watches files for now. Local feeds elsewhere refresh
+// on their schedule alone.
 #if defined(__linux__)
+#include "watch.h"
 #include "memory_linux.c"
+#include "watch_linux.c"
 #elif defined(_WIN64)
 #include "memory_windows.c"
 #else
@@ -42,8 +53,11 @@
 #include "arena.c"
 #include "date_time.c"
 #include "str.c"
+#include "encoding.c"
 #include "rss.c"
+#include "fetch.c"
 #include "db.c"
+#include "schedule.c"
 #include "err.c"
 #include "font.c"
 #include "linalg.c"
@@ -51,7 +65,6 @@
 #include "pool.c"
 #include "ui.c"
 #include "renderer.c"
-#include "string_table.c"
 #include "multithreading.c"
 
 enum { FPS = 60 };
@@ -59,7 +72,6 @@ global u32 delta_ms = 1000 / FPS;
 
 global arena GlobalArena;
 global pool LinkPool;
-global pool MessagePool;
 
 global sqlite3 *db;
 
@@ -81,120 +93,383 @@ global char modifier_key_map[256] =
 };
 
 global task_queue TaskQueue;
+global fetch_engine FetchEngine;
+global feed_schedule FeedSchedule = { .Mutex = PTHREAD_MUTEX_INITIALIZER };
+global in_flight_feeds InFlightFeeds = { .Mutex = PTHREAD_MUTEX_INITIALIZER };
+#if defined(__linux__)
+global file_watcher FileWatcher = { .Handle = -1 };
+#endif
+
+// NOTE(ariel) Transfers in flight at once by default, independent of the
+// number of threads, and requests in flight to any one host at once.
+enum
+{
+	DEFAULT_CONCURRENT_TRANSFERS = 256,
+	MAX_TRANSFERS_PER_HOST       = 6,
+};
+
+// NOTE(ariel) Seconds to put off the refresh of a feed while every link is in
+// use by refreshes in flight.
+enum { DEFERRED_REFRESH_DELAY = 5 };
+
+// NOTE(ariel) Count responses that spared the program a parse, either because
+// the server answered 304 or because the body matched the last one that parsed.
+// Only the main thread counts them as it applies results.
+typedef struct refresh_stats refresh_stats;
+struct refresh_stats
+{
+	s32 ResponseCount;
+	s32 NotModifiedCount;
+	s32 SameBodyCount;
+};
+global refresh_stats RefreshStats;
 
 typedef struct link_to_query link_to_query;
 struct link_to_query
 {
 	string Link;
+	task_priority Priority;
 	char Buffer[64];
+
+	// NOTE(ariel) The main thread reads these from the database as it enqueues
+	// the link, so that workers never touch the database. Only local feeds keep
+	// their ETag here, which always fits.
+	u64 StoredBodyHash;
+	string StoredETag;
+	char StoredETagBuffer[64];
 };
 
-typedef struct message_stack message_stack;
-struct message_stack
+// NOTE(ariel) Lanes of the fetch engine line up with lanes of the task queue,
+// so a feed keeps its priority from fetch to parse.
+StaticAssert((s32)FETCH_PRIORITY_INTERACTIVE == (s32)TASK_PRIORITY_INTERACTIVE);
+StaticAssert((s32)FETCH_PRIORITY_VISIBLE == (s32)TASK_PRIORITY_VISIBLE);
+StaticAssert((s32)FETCH_PRIORITY_BACKGROUND == (s32)TASK_PRIORITY_BACKGROUND);
+
+// NOTE(ariel) Feeds the user expanded as of the last frame, whose refreshes
+// jump ahead of feeds out of sight.
+typedef struct visible_feeds visible_feeds;
+struct visible_feeds
 {
-	String_Node *_Atomic FirstMessage;
-	pthread_mutex_t TableLock;
-	String_Table Table;
+	s32 FeedCount;
+	u32 FeedIDs[64];
 };
-global message_stack MessageStack = { .TableLock = PTHREAD_MUTEX_INITIALIZER };
+global visible_feeds VisibleFeeds;
+
+static task_priority
+GetFeedPriority(string Link)
+{
+	task_priority Priority = TASK_PRIORITY_BACKGROUND;
+	u32 FeedID = db_hash(Link);
+	for(s32 Index = 0; Index < VisibleFeeds.FeedCount; Index += 1)
+	{
+		if(VisibleFeeds.FeedIDs[Index] == FeedID)
+		{
+			Priority = TASK_PRIORITY_VISIBLE;
+			break;
+		}
+	}
+	return Priority;
+}
+
+enum
+{
+	MAX_MESSAGE_COUNT = 256,
+	MAX_MESSAGE_LENGTH = 512,
+};
+
+// NOTE(ariel) Only the main thread pushes messages, as it applies the results
+// of refreshes, so the ring needs no synchronization. It keeps the newest
+// messages and overwrites the oldest one once it fills, so a long session never
+// runs out of room for messages nor grows without bound.
+typedef struct message_ring message_ring;
+struct message_ring
+{
+	s32 Count;
+	s32 NextIndex;
+	string Messages[MAX_MESSAGE_COUNT];
+	char Buffers[MAX_MESSAGE_COUNT][MAX_MESSAGE_LENGTH];
+};
+global message_ring MessageRing;
 
 static void
 PushMessage(string Message)
 {
-	String_Node *NewMessage = AllocatePoolSlot(&MessagePool);
+	s32 Index = MessageRing.NextIndex;
+	MessageRing.NextIndex = (Index + 1) % MAX_MESSAGE_COUNT;
+	MessageRing.Count = MIN(MessageRing.Count + 1, MAX_MESSAGE_COUNT);
+
+	// NOTE(ariel) Truncate messages that don't fit into their slot, backing up to
+	// the start of the character the cut would otherwise split.
+	s32 Length = MIN(Message.len, MAX_MESSAGE_LENGTH);
+	while(Length > 0 && Length < Message.len && (Message.str[Length] & 0xc0) == 0x80)
+	{
+		Length -= 1;
+	}
+	memcpy(MessageRing.Buffers[Index], Message.str, Length);
+	MessageRing.Messages[Index].str = MessageRing.Buffers[Index];
+	MessageRing.Messages[Index].len = Length;
+}
+
+typedef struct extracted_feed extracted_feed;
+struct extracted_feed
+{
+	arena *Arena;
+	b32 HasTitle;
+	string Title;
+	RSS_Item *FirstItem;
+	RSS_Item *LastItem;
+	s32 ItemCount;
+	refresh_hints Hints;
+};
+
+static void
+StoreFeedTitle(void *UserData, string Title)
+{
+	extracted_feed *Feed = UserData;
+	Feed->HasTitle = true;
+	Feed->Title = Title;
+}
+
+static void
+StoreFeedItem(void *UserData, RSS_Item *Item)
+{
+	extracted_feed *Feed = UserData;
 
-	pthread_mutex_lock(&MessageStack.TableLock);
+	// NOTE(ariel) Hold onto items until the parser finishes without errors
+	// rather than write them to the database as they arrive.
+	RSS_Item *NewItem = PushStructToArena(Feed->Arena, RSS_Item);
+	*NewItem = *Item;
+	NewItem->next = 0;
+	if(Feed->LastItem)
+	{
+		Feed->LastItem->next = NewItem;
+	}
+	else
 	{
-		NewMessage->string = intern(&MessageStack.Table, Message);
+		Feed->FirstItem = NewItem;
 	}
-	pthread_mutex_unlock(&MessageStack.TableLock);
+	Feed->LastItem = NewItem;
+	Feed->ItemCount += 1;
+}
+
+static void
+StoreFeedRefreshHint(void *UserData, RSS_Name_ID NameID, string Content)
+{
+	extracted_feed *Feed = UserData;
+	StoreRefreshHint(&Feed->Hints, NameID, Content);
+}
 
+// NOTE(ariel) Parse responses at least this large in parallel once they finish
+// downloading rather than piece by piece as they arrive.
+#define PARALLEL_PARSE_THRESHOLD MB(4)
+
+typedef struct parallel_parse parallel_parse;
+struct parallel_parse
+{
+	_Atomic s32 ReferenceCount;
+	_Atomic s32 NextRangeIndex;
+	_Atomic s32 CompletedRangeCount;
+	RSS_Range_List Ranges;
+};
+
+static void
+ParseRanges(parallel_parse *Job)
+{
 	for(;;)
 	{
-		// NOTE(ariel) This stack doesn't stricly require generation counts because
-		// the program only pushes onto it. It never pops.
-		String_Node *OldFirstMessage = MessageStack.FirstMessage;
-		NewMessage->next = OldFirstMessage;
-		if(atomic_compare_exchange_weak(&MessageStack.FirstMessage, &OldFirstMessage, NewMessage))
+		s32 RangeIndex = atomic_fetch_add(&Job->NextRangeIndex, 1);
+		if(RangeIndex >= Job->Ranges.count)
 		{
 			break;
 		}
+		parse_rss_range(&Job->Ranges.ranges[RangeIndex]);
+		atomic_fetch_add(&Job->CompletedRangeCount, 1);
 	}
 }
 
-typedef struct curl_response curl_response;
-struct curl_response
+static void
+ReleaseParallelParse(parallel_parse *Job)
 {
-	thread_info *Thread;
-	string Data;
-};
+	if(atomic_fetch_sub(&Job->ReferenceCount, 1) == 1)
+	{
+		free(Job);
+	}
+}
 
-static ssize
-StoreResponseFromCurl(void *Data, size_t Size, size_t Count, void *CustomUserData)
+static void
+HelpParseRanges(s32 ThreadID, void *Data)
+{
+	(void)ThreadID;
+	parallel_parse *Job = Data;
+	ParseRanges(Job);
+	ReleaseParallelParse(Job);
+}
+
+static RSS_Tree *
+ParseInParallel(thread_info *Thread, task_priority Priority, string Source, RSS_Range_List *Ranges)
 {
-	ssize TotalBytes = Size * Count;
+	// NOTE(ariel) Split the source into more ranges than there are threads so
+	// that threads that finish early take on the ranges that remain.
+	s32 ThreadCount = TaskQueue.AdditionalThreadCount;
+	parallel_parse *Job = calloc(1, sizeof(parallel_parse));
+	Job->Ranges = split_rss(&Thread->ScratchArena, Source, 2*ThreadCount);
 
-	curl_response *Response = CustomUserData;
-	if(Response->Data.str)
+	s32 HelperCount = MAX(MIN(ThreadCount - 1, Job->Ranges.count - 1), 0);
+	Job->ReferenceCount = HelperCount + 1;
+	for(s32 HelperIndex = 0; HelperIndex < HelperCount; HelperIndex += 1)
 	{
-		Response->Data.str = ReallocFromArena(&Response->Thread->ScratchArena, Response->Data.len + TotalBytes);
+		// NOTE(ariel) Helpers are optional. Rather than wait on a full queue, drop
+		// the reference of each helper that didn't fit.
+		if(!TryAddTaskToQueue(&TaskQueue, Priority, HelpParseRanges, Job))
+		{
+			ReleaseParallelParse(Job);
+		}
 	}
-	else
+
+	// NOTE(ariel) This thread parses ranges too, so it only ever waits on ranges
+	// other threads already started. Helpers that start after the last range
+	// find nothing left to do, so the job lives until the last one releases it.
+	ParseRanges(Job);
+	while(Job->CompletedRangeCount < Job->Ranges.count)
 	{
-		Response->Data.str = ReallocFromArena(&Response->Thread->ScratchArena, TotalBytes);
+		sched_yield();
 	}
 
-	assert(TotalBytes <= INT32_MAX);
-	memcpy(Response->Data.str + Response->Data.len, Data, TotalBytes);
-	Response->Data.len += (s32)TotalBytes;
+	*Ranges = Job->Ranges;
+	ReleaseParallelParse(Job);
 
-	return TotalBytes;
+	RSS_Tree *Tree = stitch_rss(&Thread->PersistentArena, Source, *Ranges);
+	return Tree;
 }
 
-static void
-ParseFeed(s32 ThreadID, void *Data)
+typedef u8 refresh_status;
+enum
 {
-	thread_info *Thread = &TaskQueue.ThreadInfo[ThreadID];
-	string Link = *(string *)Data;
+	REFRESH_STATUS_PARSED,
+	REFRESH_STATUS_NOT_MODIFIED,
+	REFRESH_STATUS_SAME_CONTENT,
+	REFRESH_STATUS_FAILED,
+};
 
-	char *NullTerminatedLink = string_terminate(&Thread->ScratchArena, Link);
-	curl_response Resource = { .Thread = Thread };
-	curl_easy_setopt(Thread->CurlHandle, CURLOPT_URL, NullTerminatedLink);
-	curl_easy_setopt(Thread->CurlHandle, CURLOPT_WRITEFUNCTION, StoreResponseFromCurl);
-	curl_easy_setopt(Thread->CurlHandle, CURLOPT_WRITEDATA, &Resource);
+// NOTE(ariel) Workers only read the database. They describe what each refresh
+// found in one of these records and post it to the main thread, which applies
+// every record that arrived since the last frame in one transaction. Strings
+// and items refer to memory the record owns.
+typedef struct refresh_result refresh_result;
+struct refresh_result
+{
+	refresh_result *Next;
+	link_to_query *LinkToQuery;
+	u32 FeedID;
+	refresh_status Status;
+	string Message;
+
+	// NOTE(ariel) Only parsed feeds fill the following fields. Authors may leave
+	// the title blank, in which case it's empty.
+	string Title;
+	RSS_Item *FirstItem;
+	s32 ItemCount;
+	string ETag;
+	string LastModified;
+	u64 BodyHash;
+	s64 Interval;
+	u32 SkipHours;
+	s64 CompressedByteCount;
+	s64 DecompressedByteCount;
+
+	s64 FetchMicroseconds;
+	s64 ParseMicroseconds;
+};
+
+// NOTE(ariel) Workers push results onto this stack, and the main thread takes
+// all of them at once, so it never contends with workers over single records.
+typedef struct refresh_channel refresh_channel;
+struct refresh_channel
+{
+	refresh_result *_Atomic FirstResult;
+};
+global refresh_channel RefreshChannel;
+
+static void
+ProcessFeed(thread_info *Thread, link_to_query *LinkToQuery, fetch_transfer *Transfer, refresh_result *Refresh, b32 AllowParallelParse)
+{
+	string Link = LinkToQuery->Link;
+	curl_response *Resource = &Transfer->Response;
+	if(Transfer->CurlHandle)
+	{
+		curl_off_t FetchMicroseconds = 0;
+		curl_easy_getinfo(Transfer->CurlHandle, CURLINFO_TOTAL_TIME_T, &FetchMicroseconds);
+		Refresh->FetchMicroseconds = FetchMicroseconds;
+	}
 
-	// NOTE(ariel) libcurl creates its own thread.
-	CURLcode CurlResult = curl_easy_perform(Thread->CurlHandle);
-	if(CurlResult != CURLE_OK)
+	if(Transfer->Result != CURLE_OK)
 	{
-		char *NullTerminatedCurlErrorMessage = (char *)curl_easy_strerror(CurlResult);
+		char *NullTerminatedCurlErrorMessage = Resource->ExceededSizeLimit
+			? "response exceeds size limit after decompression"
+			: (char *)curl_easy_strerror(Transfer->Result);
 		string CurlErrorMessage =
 		{
 			.str = NullTerminatedCurlErrorMessage,
 			.len = (s32)strlen(NullTerminatedCurlErrorMessage),
 		};
 		string Strings[] = { Link, string_literal(" "), CurlErrorMessage };
-		string FormattedMessage = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
-		PushMessage(FormattedMessage);
-		curl_easy_reset(Thread->CurlHandle);
+		Refresh->Message = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
+		Refresh->Status = REFRESH_STATUS_FAILED;
 		return;
 	}
 
-	long HTTPResponseCode;
-	curl_easy_getinfo(Thread->CurlHandle, CURLINFO_RESPONSE_CODE, &HTTPResponseCode);
-	if(HTTPResponseCode != 200)
+	if(Transfer->HTTPResponseCode == 304)
+	{
+		// NOTE(ariel) The server confirmed the feed hasn't changed since the last
+		// response that parsed, so neither parse it nor touch the database.
+		string Strings[] = { Link, string_literal(" unchanged since last fetch") };
+		Refresh->Message = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
+		Refresh->Status = REFRESH_STATUS_NOT_MODIFIED;
+		return;
+	}
+
+	if(Transfer->HTTPResponseCode != 200)
 	{
 		string Strings[] = { string_literal("response code for "), Link, string_literal(" != 200") };
-		string FormattedMessage = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
-		PushMessage(FormattedMessage);
-		curl_easy_reset(Thread->CurlHandle);
+		Refresh->Message = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
+		Refresh->Status = REFRESH_STATUS_FAILED;
 		return;
 	}
 
-	curl_easy_reset(Thread->CurlHandle);
+	if(Resource->BodyHash == LinkToQuery->StoredBodyHash)
+	{
+		// NOTE(ariel) Plenty of servers ignore validators or regenerate the same
+		// feed on every request. A body identical to the last one that parsed
+		// can't hold anything new either.
+		string Strings[] = { Link, string_literal(" unchanged since last fetch (same content)") };
+		Refresh->Message = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
+		Refresh->Status = REFRESH_STATUS_SAME_CONTENT;
+		return;
+	}
 
-	string RSS = Resource.Data;
-	RSS_Tree *Feed = parse_rss(&Thread->PersistentArena, RSS);
+	extracted_feed Extracted = { .Arena = &Thread->PersistentArena };
+	RSS_Handlers Handlers =
+	{
+		.user_data = &Extracted,
+		.feed_title = StoreFeedTitle,
+		.item = StoreFeedItem,
+		.refresh_hint = StoreFeedRefreshHint,
+	};
+
+	s64 ParseStart = GetMicroseconds();
+	RSS_Tree *Feed = 0;
+	if(AllowParallelParse && TaskQueue.AdditionalThreadCount > 1 && Resource->Data.len >= PARALLEL_PARSE_THRESHOLD)
+	{
+		RSS_Range_List Ranges = {0};
+		Feed = ParseInParallel(Thread, Refresh->LinkToQuery->Priority, Resource->Data, &Ranges);
+		extract_rss_from_tree(&Thread->ScratchArena, Feed, &Handlers);
+		release_rss_ranges(Ranges);
+	}
+	else
+	{
+		Feed = extract_rss(&Thread->PersistentArena, Resource->Data, &Handlers);
+	}
+	Refresh->ParseMicroseconds = GetMicroseconds() - ParseStart;
 
 	if(Feed->errors.first)
 	{
@@ -210,71 +485,693 @@ ParseFeed(s32 ThreadID, void *Data)
 			Error = Error->next;
 		}
 
-		string FormattedMessage = string_list_concat(&Thread->ScratchArena, List);
-		PushMessage(FormattedMessage);
+		Refresh->Message = string_list_concat(&Thread->ScratchArena, List);
+		Refresh->Status = REFRESH_STATUS_FAILED;
 		return;
 	}
 
-	if(Feed->root)
+	if(Extracted.HasTitle)
+	{
+		// NOTE(ariel) Feeds don't necessarily need to be filled; that is, empty
+		// feeds are valid.
+		Refresh->Status = REFRESH_STATUS_PARSED;
+		Refresh->Title = Extracted.Title;
+		Refresh->FirstItem = Extracted.FirstItem;
+		Refresh->ItemCount = Extracted.ItemCount;
+		Refresh->ETag = Resource->ETag;
+		Refresh->LastModified = Resource->LastModified;
+		Refresh->BodyHash = Resource->BodyHash;
+		Refresh->CompressedByteCount = Resource->CompressedByteCount;
+		Refresh->DecompressedByteCount = Resource->DecompressedByteCount;
+
+		s64 *ItemTimestamps = PushArrayToArena(&Thread->ScratchArena, s64, Extracted.ItemCount);
+		s32 ItemIndex = 0;
+		for(RSS_Item *Item = Extracted.FirstItem; Item; Item = Item->next, ItemIndex += 1)
+		{
+			Timestamp ItemTimestamp = parse_date_time(Item->date);
+			ItemTimestamps[ItemIndex] = ItemTimestamp.error.str ? 0 : (s64)ItemTimestamp.unix_format;
+		}
+		Refresh->Interval = ComputeRefreshInterval(Extracted.Hints, ItemTimestamps, Extracted.ItemCount, time(0));
+		Refresh->SkipHours = Extracted.Hints.SkipHours;
+	}
+	else
+	{
+		// NOTE(ariel) Invalidate feeds without a title tag.
+		string Strings[] = { string_literal("failed to parse title of "), Link };
+		Refresh->Message = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
+		Refresh->Status = REFRESH_STATUS_FAILED;
+	}
+}
+
+static string
+CopyStringToBlock(u8 **Cursor, string Source)
+{
+	string Result = { .str = (char *)*Cursor, .len = Source.len };
+	if(Source.len)
+	{
+		memcpy(*Cursor, Source.str, Source.len);
+	}
+	*Cursor += Source.len;
+	return Result;
+}
+
+static void
+PostRefreshResult(refresh_result *Refresh)
+{
+	// NOTE(ariel) Copy the result out of the worker's arenas into one block that
+	// the main thread frees once it applies the result.
+	ssize ByteCount = sizeof(refresh_result) + Refresh->ItemCount*sizeof(RSS_Item);
+	ByteCount += Refresh->Message.len + Refresh->Title.len + Refresh->ETag.len + Refresh->LastModified.len;
+	for(RSS_Item *Item = Refresh->FirstItem; Item; Item = Item->next)
+	{
+		ByteCount += Item->title.len + Item->link.len + Item->date.len;
+	}
+
+	refresh_result *Result = malloc(ByteCount);
+	AssertAlways(Result);
+	*Result = *Refresh;
+	RSS_Item *Items = (RSS_Item *)(Result + 1);
+	u8 *Cursor = (u8 *)(Items + Refresh->ItemCount);
+	Result->Message = CopyStringToBlock(&Cursor, Refresh->Message);
+	Result->Title = CopyStringToBlock(&Cursor, Refresh->Title);
+	Result->ETag = CopyStringToBlock(&Cursor, Refresh->ETag);
+	Result->LastModified = CopyStringToBlock(&Cursor, Refresh->LastModified);
+
+	Result->FirstItem = 0;
+	s32 ItemIndex = 0;
+	for(RSS_Item *Item = Refresh->FirstItem; Item; Item = Item->next, ItemIndex += 1)
+	{
+		RSS_Item *NewItem = &Items[ItemIndex];
+		NewItem->title = CopyStringToBlock(&Cursor, Item->title);
+		NewItem->link = CopyStringToBlock(&Cursor, Item->link);
+		NewItem->date = CopyStringToBlock(&Cursor, Item->date);
+		NewItem->next = Item->next ? &Items[ItemIndex + 1] : 0;
+		Result->FirstItem = Items;
+	}
+
+	for(;;)
+	{
+		refresh_result *OldFirstResult = RefreshChannel.FirstResult;
+		Result->Next = OldFirstResult;
+		if(atomic_compare_exchange_weak(&RefreshChannel.FirstResult, &OldFirstResult, Result))
+		{
+			break;
+		}
+	}
+}
+
+static void
+RescheduleFeed(string Link, refresh_result *Refresh)
+{
+	s64 StoredInterval = 0;
+	u32 StoredSkipHours = 0;
+	s64 NextRefresh = 0;
+	if(db_get_feed_schedule(db, Link, &StoredInterval, &StoredSkipHours, &NextRefresh))
 	{
-		Feed->feed_title = find_feed_title(&Thread->ScratchArena, Feed->root);
-		if(!Feed->feed_title)
+		// NOTE(ariel) Keep the interval of the last response that parsed if this
+		// one didn't, e.g. because it failed or didn't change.
+		s64 Interval = Refresh->Interval;
+		u32 SkipHours = Refresh->SkipHours;
+		if(!Interval)
+		{
+			Interval = StoredInterval ? StoredInterval : DEFAULT_REFRESH_INTERVAL;
+			SkipHours = StoredSkipHours;
+		}
+		NextRefresh = SkipToAllowedHour(time(0) + Interval, SkipHours);
+
+		// NOTE(ariel) Retry a failing feed once its backoff ends rather than on its
+		// usual schedule.
+		s32 FailureCount = 0;
+		s64 RetryTime = 0;
+		if(Refresh->Status == REFRESH_STATUS_FAILED)
 		{
-			// NOTE(ariel) Invalidate feeds without a title tag.
-			string Strings[] = { string_literal("failed to parse title of "), Link };
-			string FormattedMessage = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
-			PushMessage(FormattedMessage);
-			return;
+			db_get_feed_failures(db, Link, &FailureCount, &RetryTime);
+			FailureCount += 1;
+			u64 Seed = (u64)time(0) ^ ((u64)db_hash(Link) << 32);
+			RetryTime = time(0) + ComputeRetryDelay(FailureCount, Seed);
+			NextRefresh = RetryTime;
 		}
+		db_set_feed_failures(db, Link, FailureCount, RetryTime);
+
+		db_set_feed_schedule(db, Link, Interval, SkipHours, NextRefresh);
+		ScheduleFeed(&FeedSchedule, Link, NextRefresh);
+	}
+}
+
+static void
+ApplyRefreshResult(refresh_result *Result)
+{
+	link_to_query *LinkToQuery = Result->LinkToQuery;
+	string Link = LinkToQuery->Link;
 
+	RefreshStats.ResponseCount += Result->Status != REFRESH_STATUS_FAILED;
+	RefreshStats.NotModifiedCount += Result->Status == REFRESH_STATUS_NOT_MODIFIED;
+	RefreshStats.SameBodyCount += Result->Status == REFRESH_STATUS_SAME_CONTENT;
+
+	char SuccessMessage[MAX_MESSAGE_LENGTH + 2];
+	if(Result->Status == REFRESH_STATUS_PARSED)
+	{
 		string FeedName = Link;
-		if(Feed->feed_title->content.str)
+		if(Result->Title.len)
 		{
-			// NOTE(ariel) Authors may leave title blank.
-			FeedName = Feed->feed_title->content;
+			FeedName = Result->Title;
 			db_add_or_update_feed(db, Link, FeedName);
 		}
 
-		// NOTE(ariel) Feeds don't necessarily need to be filled; that is, empty
-		// feeds are valid.
-		Feed->first_item = find_item_node(&Thread->ScratchArena, Feed->root);
-		for(RSS_Tree_Node *Item = Feed->first_item; Item; Item = Item->next_sibling)
+		s32 NewItemCount = 0;
+		for(RSS_Item *Item = Result->FirstItem; Item; Item = Item->next)
+		{
+			NewItemCount += db_add_item(db, Link, Item);
+		}
+
+		// NOTE(ariel) Only remember validators of responses stored in full, so that
+		// a failed parse never turns into a 304 on the next fetch.
+		db_set_feed_validators(db, Link, Result->ETag, Result->LastModified);
+		db_set_feed_body_hash(db, Link, Result->BodyHash);
+
+		// NOTE(ariel) Format the message on the stack since the ring copies it
+		// anyway. Keep a byte past what the ring holds so that it sees where the
+		// character it cuts at starts.
+		s32 Length = snprintf(SuccessMessage, sizeof(SuccessMessage),
+			"successfully parsed %.*s (%d new of %d items, %lld KB received, %lld KB decompressed, fetched in %lld ms, parsed in %lld ms)",
+			FeedName.len, FeedName.str, NewItemCount, Result->ItemCount,
+			(long long)Result->CompressedByteCount >> 10, (long long)Result->DecompressedByteCount >> 10,
+			(long long)Result->FetchMicroseconds / 1000, (long long)Result->ParseMicroseconds / 1000);
+		Result->Message.str = SuccessMessage;
+		Result->Message.len = CLAMP(Length, 0, (s32)sizeof(SuccessMessage) - 1);
+	}
+	PushMessage(Result->Message);
+
+	RescheduleFeed(Link, Result);
+	EndRefresh(&InFlightFeeds, Result->FeedID);
+
+	// NOTE(ariel) Release everything the feed held no matter how processing it
+	// ended.
+	if(Link.len > (ssize)sizeof(LinkToQuery->Buffer))
+	{
+		free(Link.str);
+	}
+	ReleasePoolSlot(&LinkPool, LinkToQuery);
+	free(Result);
+}
+
+static void
+ApplyRefreshResults(void)
+{
+	// NOTE(ariel) Take every result at once and reverse them to apply them in
+	// the order they arrived.
+	refresh_result *Result = atomic_exchange(&RefreshChannel.FirstResult, 0);
+	refresh_result *FirstResult = 0;
+	while(Result)
+	{
+		refresh_result *Next = Result->Next;
+		Result->Next = FirstResult;
+		FirstResult = Result;
+		Result = Next;
+	}
+
+	if(FirstResult)
+	{
+		db_begin_transaction(db);
+		for(Result = FirstResult; Result;)
 		{
-			db_add_item(db, Link, Item);
+			refresh_result *Next = Result->Next;
+			ApplyRefreshResult(Result);
+			Result = Next;
 		}
+		db_end_transaction(db);
+	}
+}
+
+static void
+RefreshFeed(thread_info *Thread, link_to_query *LinkToQuery, fetch_transfer *Transfer)
+{
+	string Link = LinkToQuery->Link;
+
+	refresh_result Refresh = { .LinkToQuery = LinkToQuery, .FeedID = db_hash(Link) };
+	ProcessFeed(Thread, LinkToQuery, Transfer, &Refresh, true);
+	PostRefreshResult(&Refresh);
+
+	ClearArena(&Thread->ScratchArena);
+	ClearArena(&Thread->PersistentArena);
+}
+
+static void
+ParseFeed(s32 ThreadID, void *Data)
+{
+	thread_info *Thread = &TaskQueue.ThreadInfo[ThreadID];
+	fetch_transfer *Transfer = Data;
+	RefreshFeed(Thread, Transfer->UserData, Transfer);
+	ReleaseTransfer(&FetchEngine, Transfer);
+}
+
+static string
+LocalFeedPath(string Link)
+{
+	string Scheme = string_literal("file://");
+	string Path = {0};
+	if(string_match(string_substr(Link, 0, Scheme.len), Scheme))
+	{
+		Path = string_substr(Link, Scheme.len, Link.len - Scheme.len);
+	}
+	return Path;
+}
+
+static void
+PrepareLocalFeed(thread_info *Thread, string Bytes, curl_response *Resource)
+{
+	// NOTE(ariel) Parse the file in place if it's already valid UTF-8, and only
+	// copy it to transcode it otherwise.
+	if(!view_utf8_document(Bytes, &Resource->Data))
+	{
+		Resource->Data = transcode_document_to_utf8(&Thread->PersistentArena, Bytes, (string){0});
+	}
+	Resource->BodyHash = HashBody(Bytes);
+	Resource->CompressedByteCount = (s64)Bytes.len;
+	Resource->DecompressedByteCount = (s64)Bytes.len;
+}
+
+static string
+FormatLocalFeedVersion(arena *Arena, u64 ByteCount, s64 ModifiedTime)
+{
+	// NOTE(ariel) The time the file was modified and its size stand in for an
+	// ETag, so that a file that hasn't changed since it last parsed is as good
+	// as a 304.
+	char Version[64] = {0};
+	snprintf(Version, sizeof(Version), "\"%llx-%llx\"", (unsigned long long)ModifiedTime, (unsigned long long)ByteCount);
+	return string_duplicate(Arena, (string){ .str = Version, .len = (s32)strlen(Version) });
+}
 
-		string Strings[] = { string_literal("successfully parsed "), FeedName };
-		string FormattedMessage = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
-		PushMessage(FormattedMessage);
+typedef struct local_feed_read local_feed_read;
+struct local_feed_read
+{
+	thread_info *Thread;
+	link_to_query *LinkToQuery;
+	fetch_transfer *Transfer;
+	refresh_result *Refresh;
+	string Bytes;
+};
+
+static void
+ReadMappedLocalFeed(void *Data)
+{
+	local_feed_read *Read = Data;
+	thread_info *Thread = Read->Thread;
+	refresh_result *Refresh = Read->Refresh;
+
+	// NOTE(ariel) Parse serially so that only this thread ever reads the mapping,
+	// and copy whatever the result still points to in it before the guard ends.
+	PrepareLocalFeed(Thread, Read->Bytes, &Read->Transfer->Response);
+	ProcessFeed(Thread, Read->LinkToQuery, Read->Transfer, Refresh, false);
+	Refresh->Title = string_duplicate(&Thread->PersistentArena, Refresh->Title);
+	for(RSS_Item *Item = Refresh->FirstItem; Item; Item = Item->next)
+	{
+		Item->title = string_duplicate(&Thread->PersistentArena, Item->title);
+		Item->link = string_duplicate(&Thread->PersistentArena, Item->link);
+		Item->date = string_duplicate(&Thread->PersistentArena, Item->date);
+	}
+}
+
+static CURLcode
+CopyLocalFeed(thread_info *Thread, char *Path, curl_response *Resource)
+{
+	CURLcode Result = CURLE_OK;
+
+	u64 ByteCount = 0;
+	s64 ModifiedTime = 0;
+	FILE *File = fopen(Path, "rb");
+	if(!File || !GetFileVersion(Path, &ByteCount, &ModifiedTime))
+	{
+		Result = CURLE_FILE_COULDNT_READ_FILE;
+	}
+	else if(ByteCount > MAX_DECOMPRESSED_RESPONSE_SIZE)
+	{
+		Result = CURLE_FILESIZE_EXCEEDED;
 	}
 	else
 	{
-		// TODO(ariel) All this formatted should be done in push_message() -- make
-		// it a variadic function.
-		string Strings[] = { string_literal("failed to parse title of %.*s\n"), Link };
-		string FormattedMessage = concat_strings(&Thread->ScratchArena, ARRAY_COUNT(Strings), Strings);
-		PushMessage(FormattedMessage);
+		// NOTE(ariel) Read one byte more than the file held a moment ago to notice
+		// whether it grew in the meantime.
+		u8 *Bytes = PushArrayToArena(&Thread->PersistentArena, u8, ByteCount + 1);
+		u64 ReadCount = fread(Bytes, 1, ByteCount + 1, File);
+		PrepareLocalFeed(Thread, (string){ .str = (char *)Bytes, .len = (s32)MIN(ReadCount, ByteCount) }, Resource);
+
+		// NOTE(ariel) Only vouch for the version of a copy that matches it, so
+		// that the next refresh reads the file again otherwise.
+		u64 NewByteCount = 0;
+		s64 NewModifiedTime = 0;
+		b32 Unchanged = ReadCount == ByteCount &&
+			GetFileVersion(Path, &NewByteCount, &NewModifiedTime) &&
+			NewByteCount == ByteCount && NewModifiedTime == ModifiedTime;
+		Resource->ETag = Unchanged ? FormatLocalFeedVersion(&Thread->ScratchArena, ByteCount, ModifiedTime) : (string){0};
+	}
+	if(File)
+	{
+		fclose(File);
 	}
 
-	if(Link.len > 64)
+	return Result;
+}
+
+static void
+ParseLocalFeed(s32 ThreadID, void *Data)
+{
+	thread_info *Thread = &TaskQueue.ThreadInfo[ThreadID];
+	link_to_query *LinkToQuery = Data;
+	string Link = LinkToQuery->Link;
+	char *Path = string_terminate(&Thread->ScratchArena, LocalFeedPath(Link));
+	arena_checkpoint ScratchCheckpoint = SetArenaCheckpoint(&Thread->ScratchArena);
+	arena_checkpoint PersistentCheckpoint = SetArenaCheckpoint(&Thread->PersistentArena);
+
+	// NOTE(ariel) Stand in for the fetch engine so that local feeds take the
+	// same path as feeds on the network from here on.
+	fetch_transfer Transfer = { .Result = CURLE_OK, .HTTPResponseCode = 200 };
+	curl_response *Resource = &Transfer.Response;
+	refresh_result Refresh = { .LinkToQuery = LinkToQuery, .FeedID = db_hash(Link) };
+
+	u8 *Address = 0;
+	u64 ByteCount = 0;
+	s64 ModifiedTime = 0;
+	if(!MapFileForReading(Path, &Address, &ByteCount, &ModifiedTime))
 	{
-		free(Link.str);
+		Transfer.Result = CURLE_FILE_COULDNT_READ_FILE;
+		ProcessFeed(Thread, LinkToQuery, &Transfer, &Refresh, false);
+	}
+	else if(ByteCount > MAX_DECOMPRESSED_RESPONSE_SIZE)
+	{
+		Transfer.Result = CURLE_FILESIZE_EXCEEDED;
+		ProcessFeed(Thread, LinkToQuery, &Transfer, &Refresh, false);
+	}
+	else
+	{
+		Resource->ETag = FormatLocalFeedVersion(&Thread->ScratchArena, ByteCount, ModifiedTime);
+		if(string_match(LinkToQuery->StoredETag, Resource->ETag))
+		{
+			Transfer.HTTPResponseCode = 304;
+			ProcessFeed(Thread, LinkToQuery, &Transfer, &Refresh, false);
+		}
+		else
+		{
+			// NOTE(ariel) A writer may truncate the file while it's mapped, which
+			// faults reads past its new end, or rewrite it in place, which tears what
+			// the parser sees. Read a copy instead if either happened.
+			local_feed_read Read =
+			{
+				.Thread = Thread,
+				.LinkToQuery = LinkToQuery,
+				.Transfer = &Transfer,
+				.Refresh = &Refresh,
+				.Bytes = { .str = (char *)Address, .len = (s32)ByteCount },
+			};
+			u64 NewByteCount = 0;
+			s64 NewModifiedTime = 0;
+			b32 MappingIsIntact = GuardMappedFileRead(ReadMappedLocalFeed, &Read) &&
+				GetFileVersion(Path, &NewByteCount, &NewModifiedTime) &&
+				NewByteCount == ByteCount && NewModifiedTime == ModifiedTime;
+			if(!MappingIsIntact)
+			{
+				RestoreArenaFromCheckpoint(ScratchCheckpoint);
+				RestoreArenaFromCheckpoint(PersistentCheckpoint);
+				Transfer = (fetch_transfer){ .Result = CURLE_OK, .HTTPResponseCode = 200 };
+				Refresh = (refresh_result){ .LinkToQuery = LinkToQuery, .FeedID = db_hash(Link) };
+				Transfer.Result = CopyLocalFeed(Thread, Path, Resource);
+				ProcessFeed(Thread, LinkToQuery, &Transfer, &Refresh, true);
+			}
+		}
 	}
-	ReleasePoolSlot(&LinkPool, Data);
+
+	PostRefreshResult(&Refresh);
 	ClearArena(&Thread->ScratchArena);
 	ClearArena(&Thread->PersistentArena);
+	UnmapFile(Address, ByteCount);
 }
 
+#if defined(__linux__)
 static void
-EnqueueLinkToParse(string Link)
+WatchLocalFeed(string Link)
 {
+	// NOTE(ariel) Watch the directory that holds the file rather than the file
+	// itself, so the watch outlives writers that replace the file.
+	string Path = LocalFeedPath(Link);
+	s32 LastSlash = Path.len - 1;
+	while(LastSlash >= 0 && Path.str[LastSlash] != '/')
+	{
+		LastSlash -= 1;
+	}
+	if(LastSlash > 0)
+	{
+		WatchDirectory(&FileWatcher, string_substr(Path, 0, LastSlash), false);
+	}
+}
+#endif
+
+static void
+QueueParseFeed(fetch_transfer *Transfer)
+{
+	// NOTE(ariel) The fetch engine's thread only moves bytes. Worker threads
+	// parse. If they fall behind, the engine waits here rather than finish more
+	// transfers.
+	AddTaskToQueue(&TaskQueue, (task_priority)Transfer->Priority, ParseFeed, Transfer);
+}
+
+static void
+DeferRefresh(string Link)
+{
+	s64 RefreshInterval = 0;
+	u32 SkipHours = 0;
+	s64 NextRefresh = 0;
+	if(db_get_feed_schedule(db, Link, &RefreshInterval, &SkipHours, &NextRefresh))
+	{
+		NextRefresh = time(0) + DEFERRED_REFRESH_DELAY;
+		db_set_feed_schedule(db, Link, RefreshInterval, SkipHours, NextRefresh);
+		ScheduleFeed(&FeedSchedule, Link, NextRefresh);
+	}
+}
+
+static void
+EnqueueLinkToParse(string Link, task_priority Priority)
+{
+	// NOTE(ariel) Merge a request for a feed already queued or refreshing into
+	// the refresh in flight. The program then holds at most one link, one
+	// request to fetch, and one task for each feed no matter how often the user
+	// reloads it. A more urgent request still moves the refresh in flight ahead
+	// if it waits for a transfer.
+	if(!BeginRefresh(&InFlightFeeds, db_hash(Link)))
+	{
+		if(Priority != TASK_PRIORITY_BACKGROUND)
+		{
+			PromoteFetch(&FetchEngine, Link, (fetch_priority)Priority);
+		}
+		return;
+	}
+
 	link_to_query *LinkToQuery = AllocatePoolSlot(&LinkPool);
+	if((u8 *)LinkToQuery == LinkPool.Buffer)
+	{
+		// NOTE(ariel) The pool sizes itself by the feeds at startup, and the user
+		// or a watched directory may add more. Rather than share the pool's dummy
+		// slot between refreshes, try again once some finish.
+		EndRefresh(&InFlightFeeds, db_hash(Link));
+		DeferRefresh(Link);
+		return;
+	}
 	LinkToQuery->Link.len = Link.len;
 	LinkToQuery->Link.str = Link.len <= (ssize)sizeof(LinkToQuery->Buffer)
 		? LinkToQuery->Buffer
 		: calloc(Link.len, sizeof(char)); // TODO(ariel) Use table of interned strings instead of calloc().
 	memcpy(LinkToQuery->Link.str, Link.str, Link.len);
-	AddTaskToQueue(&TaskQueue, ParseFeed, LinkToQuery);
+	LinkToQuery->Priority = Priority;
+	LinkToQuery->StoredBodyHash = db_get_feed_body_hash(db, Link);
+	LinkToQuery->StoredETag = (string){0};
+
+	if(LocalFeedPath(Link).len)
+	{
+		string StoredETag = {0};
+		string StoredLastModified = {0};
+		db_get_feed_validators(db, &GlobalArena, Link, &StoredETag, &StoredLastModified);
+		if(StoredETag.len <= (ssize)sizeof(LinkToQuery->StoredETagBuffer))
+		{
+			memcpy(LinkToQuery->StoredETagBuffer, StoredETag.str, StoredETag.len);
+			LinkToQuery->StoredETag.str = LinkToQuery->StoredETagBuffer;
+			LinkToQuery->StoredETag.len = StoredETag.len;
+		}
+
+		AddTaskToQueue(&TaskQueue, Priority, ParseLocalFeed, LinkToQuery);
+		return;
+	}
+
+	// NOTE(ariel) QueueFetch() copies the validators into headers, so they only
+	// need to last until the end of the frame.
+	fetch_validators Validators = {0};
+	if(!FetchEngine.RecordDirectory)
+	{
+		// NOTE(ariel) Record whole responses rather than 304s.
+		db_get_feed_validators(db, &GlobalArena, Link, &Validators.ETag, &Validators.LastModified);
+	}
+	QueueFetch(&FetchEngine, LinkToQuery->Link, Validators, (fetch_priority)Priority, LinkToQuery);
+}
+
+static void
+RefreshDueFeeds(void)
+{
+	scheduled_feed Feed = {0};
+	while(PopDueFeed(&FeedSchedule, time(0), &Feed))
+	{
+		// NOTE(ariel) The schedule keeps entries of feeds that were deleted or
+		// refreshed ahead of time. Only the entry that matches the database is
+		// current.
+		s64 RefreshInterval = 0;
+		u32 SkipHours = 0;
+		s64 NextRefresh = 0;
+		b32 FeedExists = db_get_feed_schedule(db, Feed.Link, &RefreshInterval, &SkipHours, &NextRefresh);
+		if(FeedExists && NextRefresh == Feed.DueTime)
+		{
+			EnqueueLinkToParse(Feed.Link, GetFeedPriority(Feed.Link));
+		}
+		free(Feed.Link.str);
+	}
+}
+
+#if defined(__linux__)
+static b32
+IsFeedFileName(string Name)
+{
+	// NOTE(ariel) Skip hidden files and the backups, swap files, and autosaves
+	// editors leave next to the files they edit.
+	b32 Result = Name.len > 0 && Name.str[0] != '.' && Name.str[0] != '#' &&
+		Name.str[Name.len - 1] != '~' && Name.str[Name.len - 1] != '#';
+	char *Suffixes[] = { ".swp", ".swx", ".tmp", ".bak" };
+	for(s32 Index = 0; Result && Index < (s32)ARRAY_COUNT(Suffixes); Index += 1)
+	{
+		string Suffix = { .str = Suffixes[Index], .len = (s32)strlen(Suffixes[Index]) };
+		Result = !(Name.len >= Suffix.len && string_match(string_suffix(Name, Name.len - Suffix.len), Suffix));
+	}
+	return Result;
+}
+
+static void
+RefreshChangedFiles(void)
+{
+	changed_file File = {0};
+	while(PollChangedFile(&FileWatcher, &GlobalArena, &File))
+	{
+		// NOTE(ariel) Every file in a watched directory is a feed, while other
+		// directories are only watched for the feeds the user added from them.
+		string Strings[] = { string_literal("file://"), File.Path };
+		string Link = concat_strings(&GlobalArena, ARRAY_COUNT(Strings), Strings);
+		s64 RefreshInterval = 0;
+		u32 SkipHours = 0;
+		s64 NextRefresh = 0;
+		b32 FeedExists = db_get_feed_schedule(db, Link, &RefreshInterval, &SkipHours, &NextRefresh);
+		s32 LastSlash = File.Path.len - 1;
+		while(LastSlash >= 0 && File.Path.str[LastSlash] != '/')
+		{
+			LastSlash -= 1;
+		}
+		string Name = string_suffix(File.Path, LastSlash + 1);
+		if(!FeedExists && File.InWatchedDirectory && IsFeedFileName(Name))
+		{
+			db_add_feed(db, Link, string_literal(""));
+			FeedExists = true;
+		}
+		if(FeedExists)
+		{
+			EnqueueLinkToParse(Link, GetFeedPriority(Link));
+		}
+	}
+}
+
+static void
+AddWatchedDirectories(char *Directories)
+{
+	// NOTE(ariel) Directories are separated by colons, as in PATH.
+	string Remaining = { .str = Directories, .len = Directories ? (s32)strlen(Directories) : 0 };
+	while(Remaining.len > 0)
+	{
+		s32 Length = 0;
+		while(Length < Remaining.len && Remaining.str[Length] != ':')
+		{
+			Length += 1;
+		}
+		string Directory = string_substr(Remaining, 0, Length);
+		Remaining = string_substr(Remaining, Length + 1, Remaining.len - Length - 1);
+		if(!Directory.len)
+		{
+			continue;
+		}
+
+		WatchDirectory(&FileWatcher, Directory, true);
+
+		// NOTE(ariel) Files written while the program wasn't running become
+		// feeds now. Feeds start due, so they parse on the first frame.
+		char *TerminatedDirectory = string_terminate(&GlobalArena, Directory);
+		DIR *Handle = opendir(TerminatedDirectory);
+		if(!Handle)
+		{
+			continue;
+		}
+		for(struct dirent *Entry = readdir(Handle); Entry; Entry = readdir(Handle))
+		{
+			string Name = { .str = Entry->d_name, .len = (s32)strlen(Entry->d_name) };
+			if((Entry->d_type == DT_REG || Entry->d_type == DT_UNKNOWN) && IsFeedFileName(Name))
+			{
+				string Strings[] = { string_literal("file://"), Directory, string_literal("/"), Name };
+				string Link = concat_strings(&GlobalArena, ARRAY_COUNT(Strings), Strings);
+				s64 RefreshInterval = 0;
+				u32 SkipHours = 0;
+				s64 NextRefresh = 0;
+				if(!db_get_feed_schedule(db, Link, &RefreshInterval, &SkipHours, &NextRefresh))
+				{
+					db_add_feed(db, Link, string_literal(""));
+				}
+			}
+		}
+		closedir(Handle);
+	}
+}
+#endif
+
+static string
+format_failures(arena *Arena, s32 failure_count, s64 retry_time, s64 now)
+{
+	char *plural = failure_count == 1 ? "" : "s";
+	char *state = CircuitIsOpen(failure_count, retry_time, now) ? "paused for" : "retrying in";
+	s64 minutes = (MAX(retry_time - now, 0) + 59) / 60;
+
+	char status[128] = {0};
+	if (minutes == 0)
+	{
+		snprintf(status, sizeof(status), "failed %d time%s in a row, retrying soon", failure_count, plural);
+	}
+	else if (minutes < 120)
+	{
+		snprintf(status, sizeof(status), "failed %d time%s in a row, %s %lld minutes",
+			failure_count, plural, state, (long long)minutes);
+	}
+	else
+	{
+		snprintf(status, sizeof(status), "failed %d time%s in a row, %s %lld hours",
+			failure_count, plural, state, (long long)((minutes + 59) / 60));
+	}
+
+	string result = string_duplicate(Arena, (string){ .str = status, .len = (s32)strlen(status) });
+	return result;
+}
+
+static string
+format_refresh_stats(arena *Arena, refresh_stats *stats)
+{
+	s32 response_count = stats->ResponseCount;
+	s32 not_modified_count = stats->NotModifiedCount;
+	s32 same_body_count = stats->SameBodyCount;
+	s32 skipped_count = not_modified_count + same_body_count;
+
+	char status[128] = {0};
+	snprintf(status, sizeof(status), "%d of %d responses unchanged (%d%%): %d not modified, %d with same content",
+		skipped_count, response_count, 100*skipped_count / MAX(response_count, 1), not_modified_count, same_body_count);
+
+	string result = string_duplicate(Arena, (string){ .str = status, .len = (s32)strlen(status) });
+	return result;
 }
 
 static void
@@ -294,24 +1191,44 @@ process_frame(void)
 	if (SubmitNewFeed && NewFeed.data.len > 0)
 	{
 		db_add_feed(db, NewFeed.data, string_literal(""));
+		ScheduleFeed(&FeedSchedule, NewFeed.data, 0);
+#if defined(__linux__)
+		WatchLocalFeed(NewFeed.data);
+#endif
 		NewFeed.data.len = 0;
 	}
 
+	s64 now = time(0);
 	if (ui_button(string_literal("Reload All Feeds")))
 	{
 		string feed_link = {0};
 		string feed_title = {0};
-		while (db_iterate_feeds(db, &feed_link, &feed_title))
+		s32 failure_count = 0;
+		s64 retry_time = 0;
+		while (db_iterate_feeds(db, &feed_link, &feed_title, &failure_count, &retry_time))
 		{
-			EnqueueLinkToParse(feed_link);
+			// NOTE(ariel) Leave any feed that failed to its backoff, whether or not
+			// it's paused. Its own Reload button still fetches it right away.
+			if (now >= retry_time)
+			{
+				EnqueueLinkToParse(feed_link, GetFeedPriority(feed_link));
+			}
 		}
 	}
 
+	if (RefreshStats.ResponseCount > 0)
+	{
+		ui_text(format_refresh_stats(&GlobalArena, &RefreshStats));
+	}
+
 	ui_separator();
 
 	string feed_link = {0};
 	string feed_title = {0};
-	while (db_iterate_feeds(db, &feed_link, &feed_title))
+	s32 failure_count = 0;
+	s64 retry_time = 0;
+	VisibleFeeds.FeedCount = 0;
+	while (db_iterate_feeds(db, &feed_link, &feed_title, &failure_count, &retry_time))
 	{
 		string display_name = feed_title.len ? feed_title : feed_link;
 		s32 header_state = ui_header(display_name, UI_HEADER_SHOW_X_BUTTON);
@@ -319,8 +1236,17 @@ process_frame(void)
 		{
 			db_del_feed(db, feed_link);
 		}
+		if (failure_count > 0)
+		{
+			ui_text(format_failures(&GlobalArena, failure_count, retry_time, now));
+		}
 		if (ui_header_expanded(header_state))
 		{
+			if (VisibleFeeds.FeedCount < (s32)ARRAY_COUNT(VisibleFeeds.FeedIDs))
+			{
+				VisibleFeeds.FeedIDs[VisibleFeeds.FeedCount++] = db_hash(feed_link);
+			}
+
 			DB_Item item = {0};
 			while (db_iterate_items(db, feed_link, &item))
 			{
@@ -363,7 +1289,7 @@ process_frame(void)
 				} break;
 				case 1:
 				{
-					EnqueueLinkToParse(feed_link);
+					EnqueueLinkToParse(feed_link, TASK_PRIORITY_INTERACTIVE);
 				} break;
 				case 2:
 				{
@@ -377,23 +1303,52 @@ process_frame(void)
 
 	if (ui_header(string_literal("Messages"), 0))
 	{
-		String_Node *Message = GetAddress(MessageStack.FirstMessage);
-		while(Message)
+		// NOTE(ariel) List messages from newest to oldest.
+		for(s32 Offset = 1; Offset <= MessageRing.Count; Offset += 1)
 		{
-			ui_text(Message->string);
-			Message = Message->next;
+			s32 Index = (MessageRing.NextIndex - Offset + MAX_MESSAGE_COUNT) % MAX_MESSAGE_COUNT;
+			ui_text(MessageRing.Messages[Index]);
 		}
 	}
 
 	ui_end();
 }
 
+static s32
+GetCountFromEnvironment(char *Name, s32 DefaultCount, s32 MinCount)
+{
+	s32 Count = DefaultCount;
+	char *Value = getenv(Name);
+	if(Value && *Value)
+	{
+		char *End = 0;
+		long ParsedValue = strtol(Value, &End, 10);
+		if(!*End && ParsedValue >= MinCount && ParsedValue <= 4096)
+		{
+			Count = (s32)ParsedValue;
+		}
+		else
+		{
+			fprintf(stderr, "ignoring %s=%s, which isn't a count from %d to 4096\n", Name, Value, MinCount);
+		}
+	}
+	return Count;
+}
+
 int
 main(void)
 {
 	InitializeArena(&GlobalArena);
 
 	db_init(&db);
+
+#if defined(__linux__)
+	// NOTE(ariel) Add feeds from watched directories before sizing everything
+	// by the number of feeds.
+	StartFileWatcher(&FileWatcher);
+	AddWatchedDirectories(getenv("AGGRSS_WATCH_DIRECTORIES"));
+#endif
+
 	s32 FeedsCount = db_count_rows(db);
 	s32 MaxFeedsCount = MAX(64, 2*FeedsCount);
 
@@ -402,26 +1357,52 @@ main(void)
 	LinkPool.Buffer = PushBytesToArena(&GlobalArena, LinkPool.Capacity);
 	InitializePool(&LinkPool);
 
-	MessagePool.SlotSize = sizeof(String_Node);
-	MessagePool.Capacity = MaxFeedsCount*MessagePool.SlotSize;;
-	MessagePool.Buffer = PushBytesToArena(&GlobalArena, MessagePool.Capacity);
-	InitializePool(&MessagePool);
-
 	curl_global_init(CURL_GLOBAL_DEFAULT);
 
-	// NOTE(ariel) Initialize work queue.
+	// NOTE(ariel) Size the two pools apart. Transfers mostly wait on the
+	// network, so one thread drives plenty of them at little cost, while parse
+	// threads compete for cores. Keep at least one parse thread by default so
+	// that parsing never stalls the interface on a single core, though the main
+	// thread helps parse whenever it has time left in a frame.
+	s32 TransferCount = GetCountFromEnvironment("AGGRSS_FETCH_TRANSFERS", DEFAULT_CONCURRENT_TRANSFERS, 1);
+	s32 ParseThreadCount = GetCountFromEnvironment("AGGRSS_PARSE_THREADS", MAX(GetCPUCoreCount() - 1, 1), 0);
+	b32 PinParseThreads = GetCountFromEnvironment("AGGRSS_PIN_PARSE_THREADS", 0, 0) > 0;
+
+	// NOTE(ariel) Initialize work queue. Every transfer in flight may finish
+	// and queue its parse, which may in turn queue a helper for each thread.
+	// The queue only sizes how far producers may run ahead of workers, since it
+	// reuses its slots. Each lane holds a task for every feed at least, so the
+	// main thread never waits on a full lane it would have to empty itself.
 	{
-		TaskQueue.MaxTaskCount = MaxFeedsCount;
-		InitializeThreads(&GlobalArena, &TaskQueue);
-		for(s32 ThreadNumber = 0; ThreadNumber < TaskQueue.AdditionalThreadCount; ThreadNumber += 1)
+		TaskQueue.MaxTaskCount = MAX(TransferCount*(ParseThreadCount + 1), MaxFeedsCount);
+		InitializeThreads(&GlobalArena, &TaskQueue, ParseThreadCount, PinParseThreads);
+		for(s32 ThreadNumber = 0; ThreadNumber <= TaskQueue.AdditionalThreadCount; ThreadNumber += 1)
 		{
 			thread_info *Info = &TaskQueue.ThreadInfo[ThreadNumber];
-			Info->CurlHandle = curl_easy_init(); AssertAlways(Info->CurlHandle);
 			InitializeArena(&Info->ScratchArena);
 			InitializeArena(&Info->PersistentArena);
 		}
 	}
 
+	// NOTE(ariel) Record responses to replay them later with
+	// tests/replay_server.py, or replay them from the server at this address.
+	FetchEngine.RecordDirectory = getenv("AGGRSS_RECORD_DIRECTORY");
+	FetchEngine.ReplayAddress = getenv("AGGRSS_REPLAY_ADDRESS");
+	StartFetchEngine(&FetchEngine, &GlobalArena,
+		TransferCount, MAX_TRANSFERS_PER_HOST, MaxFeedsCount, QueueParseFeed);
+
+	{
+		string feed_link = {0};
+		s64 next_refresh = 0;
+		while (db_iterate_feed_schedule(db, &feed_link, &next_refresh))
+		{
+			ScheduleFeed(&FeedSchedule, feed_link, next_refresh);
+#if defined(__linux__)
+			WatchLocalFeed(feed_link);
+#endif
+		}
+	}
+
 	SDL_Init(SDL_INIT_VIDEO);
 	r_init(&GlobalArena);
 	ui_init();
@@ -475,6 +1456,11 @@ main(void)
 			}
 		}
 
+		ApplyRefreshResults();
+		RefreshDueFeeds();
+#if defined(__linux__)
+		RefreshChangedFiles();
+#endif
 		process_frame();
 
 		local_persist Color background = { 50, 50, 50, 255 };
@@ -483,20 +1469,25 @@ main(void)
 
 		RestoreArenaFromCheckpoint(Checkpoint);
 
-		// NOTE(ariel) Cap frames per second.
+		// NOTE(ariel) Cap frames per second. Spend the rest of the frame on tasks
+		// before sleeping through what remains of it.
 		u32 duration = SDL_GetTicks() - start;
 		if (duration < delta_ms)
+		{
+			DoTasksUntil(&TaskQueue, GetMicroseconds() + 1000*(s64)(delta_ms - duration));
+			duration = SDL_GetTicks() - start;
+		}
+		if (duration < delta_ms)
 		{
 			SDL_Delay(delta_ms - duration);
 		}
 	}
 
 exit:
-	for (s8 ThreadNumber = 0; ThreadNumber < TaskQueue.AdditionalThreadCount; ThreadNumber += 1)
-	{
-		thread_info *Info = &TaskQueue.ThreadInfo[ThreadNumber];
-		curl_easy_cleanup(Info->CurlHandle);
-	}
+#if defined(__linux__)
+	StopFileWatcher(&FileWatcher);
+#endif
+	StopFetchEngine(&FetchEngine);
 	curl_global_cleanup();
 	db_free(db);
 	return 0;
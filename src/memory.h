@@ -20,4 +20,28 @@ static void ReleaseVirtualMemory(void *Address, u64 BytesCount);
 static b32 CommitVirtualMemory(void *Address, u64 BytesCount);
 static void DecommitVirtualMemory(void *Address, u64 BytesCount);
 
+// NOTE(ariel) Move the first `UsedBytesCount` bytes of committed memory at
+// `Address` onto an unlinked temporary file of `BytesCount` bytes, mapped over
+// the whole reservation at the same address, so that the system may write its
+// pages out to the file rather than hold them in memory. Return the file, or -1
+// if the platform can't spill memory, in which case the memory stays as it was.
+static s32 SpillVirtualMemoryToFile(void *Address, u64 ReservedBytesCount, u64 UsedBytesCount, u64 BytesCount);
+static b32 GrowSpilledVirtualMemory(s32 File, u64 BytesCount);
+static void CloseSpillFile(s32 File);
+
+// NOTE(ariel) Map a whole file into memory read-only, so that the program reads
+// it in place rather than copies it. The mapping may reflect later writes to
+// the file, and reading past the end of a file truncated while mapped faults,
+// so read mappings through GuardMappedFileRead() and compare the version of the
+// file afterwards. Empty files map to no memory at all. `ModifiedTime` counts
+// nanoseconds since the Unix epoch.
+static b32 MapFileForReading(char *Path, u8 **Address, u64 *BytesCount, s64 *ModifiedTime);
+static void UnmapFile(u8 *Address, u64 BytesCount);
+static b32 GetFileVersion(char *Path, u64 *BytesCount, s64 *ModifiedTime);
+
+// NOTE(ariel) Call `Read` and return whether it finished rather than fault on a
+// mapped file that shrank under it. The platform abandons `Read` wherever it
+// faulted, so `Read` must not take locks or hold memory only it knows of.
+static b32 GuardMappedFileRead(void (*Read)(void *Data), void *Data);
+
 #endif
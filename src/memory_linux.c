@@ -1,4 +1,10 @@
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 static void *
 ReserveVirtualMemory(u64 BytesCount)
@@ -27,3 +33,145 @@ DecommitVirtualMemory(void *Address, u64 BytesCount)
 {
 	madvise(Address, BytesCount, MADV_FREE);
 }
+
+static s32
+SpillVirtualMemoryToFile(void *Address, u64 ReservedBytesCount, u64 UsedBytesCount, u64 BytesCount)
+{
+	char Path[] = "/tmp/aggrss-XXXXXX";
+	s32 File = mkstemp(Path);
+	if(File >= 0)
+	{
+		unlink(Path);
+
+		b32 Success = ftruncate(File, (off_t)BytesCount) == 0;
+		for(u64 Offset = 0; Success && Offset < UsedBytesCount;)
+		{
+			ssize_t WrittenBytesCount = pwrite(File, (u8 *)Address + Offset, UsedBytesCount - Offset, (off_t)Offset);
+			Success = WrittenBytesCount > 0;
+			Offset += Success ? (u64)WrittenBytesCount : 0;
+		}
+		Success = Success &&
+			mmap(Address, ReservedBytesCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, File, 0) != MAP_FAILED;
+
+		if(!Success)
+		{
+			close(File);
+			File = -1;
+		}
+	}
+	return File;
+}
+
+static b32
+GrowSpilledVirtualMemory(s32 File, u64 BytesCount)
+{
+	b32 Success = ftruncate(File, (off_t)BytesCount) == 0;
+	AssertAlways(Success);
+	return Success;
+}
+
+static void
+CloseSpillFile(s32 File)
+{
+	close(File);
+}
+
+static b32
+MapFileForReading(char *Path, u8 **Address, u64 *BytesCount, s64 *ModifiedTime)
+{
+	b32 Success = false;
+	s32 File = open(Path, O_RDONLY | O_CLOEXEC);
+	struct stat Status = {0};
+	if(File >= 0 && fstat(File, &Status) == 0 && S_ISREG(Status.st_mode))
+	{
+		*Address = 0;
+		*BytesCount = (u64)Status.st_size;
+		*ModifiedTime = (s64)Status.st_mtim.tv_sec*1000000000 + Status.st_mtim.tv_nsec;
+		Success = true;
+		if(*BytesCount)
+		{
+			// NOTE(ariel) The parser reads the file front to back once.
+			void *Mapping = mmap(0, *BytesCount, PROT_READ, MAP_PRIVATE, File, 0);
+			Success = Mapping != MAP_FAILED;
+			if(Success)
+			{
+				madvise(Mapping, *BytesCount, MADV_SEQUENTIAL);
+				*Address = Mapping;
+			}
+		}
+	}
+
+	// NOTE(ariel) The mapping holds onto the file after it closes.
+	if(File >= 0)
+	{
+		close(File);
+	}
+	return Success;
+}
+
+static void
+UnmapFile(u8 *Address, u64 BytesCount)
+{
+	if(BytesCount)
+	{
+		munmap(Address, BytesCount);
+	}
+}
+
+static b32
+GetFileVersion(char *Path, u64 *BytesCount, s64 *ModifiedTime)
+{
+	struct stat Status = {0};
+	b32 Success = stat(Path, &Status) == 0 && S_ISREG(Status.st_mode);
+	if(Success)
+	{
+		*BytesCount = (u64)Status.st_size;
+		*ModifiedTime = (s64)Status.st_mtim.tv_sec*1000000000 + Status.st_mtim.tv_nsec;
+	}
+	return Success;
+}
+
+typedef struct mapped_read_guard mapped_read_guard;
+struct mapped_read_guard
+{
+	sigjmp_buf Jump;
+	volatile sig_atomic_t Active;
+};
+static _Thread_local mapped_read_guard MappedReadGuard;
+
+static void
+HandleMappedReadFault(int Signal, siginfo_t *Info, void *Context)
+{
+	(void)Info;
+	(void)Context;
+	if(MappedReadGuard.Active)
+	{
+		MappedReadGuard.Active = false;
+		siglongjmp(MappedReadGuard.Jump, 1);
+	}
+
+	// NOTE(ariel) Crash as usual on faults outside guarded reads.
+	signal(Signal, SIG_DFL);
+	raise(Signal);
+}
+
+static b32
+GuardMappedFileRead(void (*Read)(void *Data), void *Data)
+{
+	// NOTE(ariel) Reading a page of a mapping past the end of its file raises
+	// SIGBUS on the thread that read it.
+	struct sigaction Action = {0};
+	Action.sa_sigaction = HandleMappedReadFault;
+	Action.sa_flags = SA_SIGINFO;
+	sigemptyset(&Action.sa_mask);
+	sigaction(SIGBUS, &Action, 0);
+
+	if(sigsetjmp(MappedReadGuard.Jump, 1))
+	{
+		return false;
+	}
+	MappedReadGuard.Active = true;
+	Read(Data);
+	MappedReadGuard.Active = false;
+	return true;
+}
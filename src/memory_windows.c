@@ -27,3 +27,98 @@ DecommitVirtualMemory(void *Address, u64 BytesCount)
 {
 	VirtualFree(Address, BytesCount, MEM_DECOMMIT);
 }
+
+static s32
+SpillVirtualMemoryToFile(void *Address, u64 ReservedBytesCount, u64 UsedBytesCount, u64 BytesCount)
+{
+	// TODO(ariel) Windows can't map a file over memory it already reserved, so
+	// memory never spills there yet.
+	(void)Address;
+	(void)ReservedBytesCount;
+	(void)UsedBytesCount;
+	(void)BytesCount;
+	return -1;
+}
+
+static b32
+GrowSpilledVirtualMemory(s32 File, u64 BytesCount)
+{
+	(void)File;
+	(void)BytesCount;
+	Assert(!"unreachable");
+	return false;
+}
+
+static void
+CloseSpillFile(s32 File)
+{
+	(void)File;
+}
+
+static b32
+MapFileForReading(char *Path, u8 **Address, u64 *BytesCount, s64 *ModifiedTime)
+{
+	b32 Success = false;
+	HANDLE File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	LARGE_INTEGER Size = {0};
+	FILETIME WriteTime = {0};
+	if(File != INVALID_HANDLE_VALUE && GetFileSizeEx(File, &Size) && GetFileTime(File, 0, 0, &WriteTime))
+	{
+		// NOTE(ariel) File times count 100 nanosecond intervals since 1601.
+		u64 Ticks = ((u64)WriteTime.dwHighDateTime << 32) | WriteTime.dwLowDateTime;
+		*Address = 0;
+		*BytesCount = (u64)Size.QuadPart;
+		*ModifiedTime = ((s64)Ticks - 116444736000000000ll)*100;
+		Success = true;
+		if(*BytesCount)
+		{
+			HANDLE Mapping = CreateFileMappingA(File, 0, PAGE_READONLY, 0, 0, 0);
+			*Address = Mapping ? MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+			Success = *Address != 0;
+			if(Mapping)
+			{
+				CloseHandle(Mapping);
+			}
+		}
+	}
+
+	if(File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(File);
+	}
+	return Success;
+}
+
+static void
+UnmapFile(u8 *Address, u64 BytesCount)
+{
+	if(BytesCount)
+	{
+		UnmapViewOfFile(Address);
+	}
+}
+
+static b32
+GetFileVersion(char *Path, u64 *BytesCount, s64 *ModifiedTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA Attributes = {0};
+	b32 Success = GetFileAttributesExA(Path, GetFileExInfoStandard, &Attributes) &&
+		!(Attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+	if(Success)
+	{
+		u64 Ticks = ((u64)Attributes.ftLastWriteTime.dwHighDateTime << 32) | Attributes.ftLastWriteTime.dwLowDateTime;
+		*BytesCount = ((u64)Attributes.nFileSizeHigh << 32) | Attributes.nFileSizeLow;
+		*ModifiedTime = ((s64)Ticks - 116444736000000000ll)*100;
+	}
+	return Success;
+}
+
+static b32
+GuardMappedFileRead(void (*Read)(void *Data), void *Data)
+{
+	// NOTE(ariel) Windows refuses to truncate a file while a view maps it, so
+	// reads of the view never fault.
+	Read(Data);
+	return true;
+}
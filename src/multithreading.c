@@ -1,3 +1,12 @@
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#elif defined(_WIN64)
+#include <windows.h>
+#endif
+
+global thread_local thread_info *CurrentThreadInfo;
+
 static inline s32
 GetCPUCoreCount(void)
 {
@@ -6,70 +15,434 @@ GetCPUCoreCount(void)
 	return CPUCoreCount;
 }
 
+static s64
+GetMicroseconds(void)
+{
+	struct timespec Time = {0};
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	s64 Microseconds = (s64)Time.tv_sec*1000000 + Time.tv_nsec/1000;
+	return Microseconds;
+}
+
+#if defined(__linux__)
+static void
+PinThreadToCPU(s32 CPU)
+{
+	// NOTE(ariel) Call the system directly, since the C library only declares
+	// its wrapper for GNU programs. Thread 0 refers to the calling thread.
+	unsigned long Mask[1024 / (8*sizeof(unsigned long))] = {0};
+	s32 BitsPerWord = 8*sizeof(unsigned long);
+	Mask[(CPU / BitsPerWord) % ARRAY_COUNT(Mask)] |= 1ul << (CPU % BitsPerWord);
+	syscall(SYS_sched_setaffinity, 0, sizeof(Mask), Mask);
+}
+
+static void
+FutexWait(_Atomic u32 *Address, u32 ExpectedValue)
+{
+	// NOTE(ariel) The system only puts the thread to sleep if the value still
+	// matches, so a wake between the caller's check and this call isn't lost.
+	syscall(SYS_futex, Address, FUTEX_WAIT_PRIVATE, ExpectedValue, 0, 0, 0);
+}
+
+static void
+FutexWake(_Atomic u32 *Address, s32 ThreadCount)
+{
+	syscall(SYS_futex, Address, FUTEX_WAKE_PRIVATE, ThreadCount, 0, 0, 0);
+}
+#elif defined(_WIN64)
+// NOTE(ariel) WaitOnAddress() and friends live in Synchronization.lib.
+static void
+PinThreadToCPU(s32 CPU)
+{
+	// NOTE(ariel) An affinity mask only covers the 64 processors of the
+	// thread's processor group.
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (CPU % 64));
+}
+
+static void
+FutexWait(_Atomic u32 *Address, u32 ExpectedValue)
+{
+	// NOTE(ariel) Like a futex, the thread only sleeps if the value still
+	// matches, though it may also wake spuriously.
+	WaitOnAddress((volatile void *)Address, &ExpectedValue, sizeof(ExpectedValue), INFINITE);
+}
+
 static void
-AddTaskToQueue(task_queue *Queue, task_to_do Procedure, void *Data)
+FutexWake(_Atomic u32 *Address, s32 ThreadCount)
 {
-	s32 TaskIndex = atomic_fetch_add(&Queue->NextTaskToAddIndex, 1);
-	Assert(TaskIndex < Queue->MaxTaskCount);
-	Assert(!Queue->Tasks[TaskIndex].Procedure);
-	Queue->Tasks[TaskIndex].Procedure = Procedure;
-	Queue->Tasks[TaskIndex].Data = Data;
-	Queue->TotalTaskCount += 1;
-	sem_post(&Queue->Semaphore);
+	if (ThreadCount == 1)
+	{
+		WakeByAddressSingle((void *)Address);
+	}
+	else
+	{
+		WakeByAddressAll((void *)Address);
+	}
 }
+#endif
 
-static task
-GetTaskFromQueue(task_queue *Queue, s32 TaskIndex)
+static void
+WakeThread(task_queue *Queue)
 {
-	task TaskToDo = Queue->Tasks[TaskIndex];
-	Assert(TaskToDo.Procedure);
-	ZeroStruct(&Queue->Tasks[TaskIndex]);
-	return TaskToDo;
+	// NOTE(ariel) Either this producer sees the parked count a worker raised or
+	// that worker sees the task this producer added before it parks.
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&Queue->ParkedThreadCount, memory_order_relaxed) > 0)
+	{
+		atomic_fetch_add(&Queue->WakeCount, 1);
+		FutexWake(&Queue->WakeCount, 1);
+	}
 }
 
+/* ---
+ * Deques
+ * ---
+ *
+ * NOTE(ariel) These follow "Correct and Efficient Work-Stealing for Weak
+ * Memory Models" by Lê, Pop, Cohen, and Zappa Nardelli. The deque never grows,
+ * so the worker pushes elsewhere once it fills. A thief only ever reads the
+ * slot at the top, which the worker can't overwrite until the top moves past it.
+ */
+
 static b32
-DoTask(task_queue *Queue, thread_id ThreadID)
+PushTaskToDeque(task_deque *Deque, task_to_do Procedure, void *Data)
 {
-	b32 ThreadShouldSleep = true;
+	s64 Bottom = atomic_load_explicit(&Deque->Bottom, memory_order_relaxed);
+	s64 Top = atomic_load_explicit(&Deque->Top, memory_order_acquire);
+	if (Bottom - Top >= TASK_DEQUE_CAPACITY)
+	{
+		return false;
+	}
+
+	task *Task = &Deque->Tasks[Bottom & (TASK_DEQUE_CAPACITY - 1)];
+	Task->Procedure = Procedure;
+	Task->Data = Data;
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&Deque->Bottom, Bottom + 1, memory_order_relaxed);
+	return true;
+}
 
-	s32 TaskToDoIndex = Queue->NextTaskToDoIndex;
-	if (TaskToDoIndex != Queue->NextTaskToAddIndex)
+static b32
+TakeTaskFromDeque(task_deque *Deque, task *Task)
+{
+	s64 Bottom = atomic_load_explicit(&Deque->Bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&Deque->Bottom, Bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	s64 Top = atomic_load_explicit(&Deque->Top, memory_order_relaxed);
+
+	b32 Taken = Top <= Bottom;
+	if (Taken)
 	{
-		s32 NewNextTaskToDoIndex = (TaskToDoIndex + 1) % Queue->MaxTaskCount;
-		b32 Exchanged = atomic_compare_exchange_strong(
-			&Queue->NextTaskToDoIndex, &TaskToDoIndex, NewNextTaskToDoIndex);
-		if (Exchanged)
+		*Task = Deque->Tasks[Bottom & (TASK_DEQUE_CAPACITY - 1)];
+		if (Top == Bottom)
 		{
-			task Task = GetTaskFromQueue(Queue, TaskToDoIndex);
-			Task.Procedure(ThreadID, Task.Data);
-			Queue->CompletedTaskCount += 1;
+			// NOTE(ariel) Race thieves for the last task.
+			Taken = atomic_compare_exchange_strong_explicit(&Deque->Top, &Top, Top + 1,
+				memory_order_seq_cst, memory_order_relaxed);
+			atomic_store_explicit(&Deque->Bottom, Bottom + 1, memory_order_relaxed);
 		}
-		ThreadShouldSleep = false;
 	}
+	else
+	{
+		atomic_store_explicit(&Deque->Bottom, Bottom + 1, memory_order_relaxed);
+	}
+	return Taken;
+}
+
+static b32
+StealTaskFromDeque(task_deque *Deque, task *Task)
+{
+	s64 Top = atomic_load_explicit(&Deque->Top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	s64 Bottom = atomic_load_explicit(&Deque->Bottom, memory_order_acquire);
+
+	b32 Stolen = false;
+	if (Top < Bottom)
+	{
+		*Task = Deque->Tasks[Top & (TASK_DEQUE_CAPACITY - 1)];
+		Stolen = atomic_compare_exchange_strong_explicit(&Deque->Top, &Top, Top + 1,
+			memory_order_seq_cst, memory_order_relaxed);
+	}
+	return Stolen;
+}
 
-	return ThreadShouldSleep;
+/* ---
+ * Shared Queue
+ * ---
+ */
+
+static b32
+PushTask(task_queue *Queue, task_lane *Lane, task_to_do Procedure, void *Data)
+{
+	u64 Mask = (u64)Queue->MaxTaskCount - 1;
+	u64 Position = atomic_load_explicit(&Lane->NextTaskToAddIndex, memory_order_relaxed);
+	for (;;)
+	{
+		task_slot *Slot = &Lane->Slots[Position & Mask];
+		u64 Sequence = atomic_load_explicit(&Slot->Sequence, memory_order_acquire);
+		s64 Difference = (s64)(Sequence - Position);
+		if (Difference == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&Lane->NextTaskToAddIndex, &Position, Position + 1,
+				memory_order_relaxed, memory_order_relaxed))
+			{
+				// NOTE(ariel) Publish the task only once it's written.
+				Slot->Task.Procedure = Procedure;
+				Slot->Task.Data = Data;
+				atomic_store_explicit(&Slot->QueuedTime, GetMicroseconds(), memory_order_relaxed);
+				atomic_store_explicit(&Slot->Sequence, Position + 1, memory_order_release);
+				return true;
+			}
+		}
+		else if (Difference < 0)
+		{
+			// NOTE(ariel) The consumer of this slot's last task hasn't taken it yet.
+			return false;
+		}
+		else
+		{
+			Position = atomic_load_explicit(&Lane->NextTaskToAddIndex, memory_order_relaxed);
+		}
+	}
+}
+
+static b32
+PopTask(task_queue *Queue, task_lane *Lane, task *Task)
+{
+	u64 Mask = (u64)Queue->MaxTaskCount - 1;
+	u64 Position = atomic_load_explicit(&Lane->NextTaskToDoIndex, memory_order_relaxed);
+	for (;;)
+	{
+		task_slot *Slot = &Lane->Slots[Position & Mask];
+		u64 Sequence = atomic_load_explicit(&Slot->Sequence, memory_order_acquire);
+		s64 Difference = (s64)(Sequence - (Position + 1));
+		if (Difference == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&Lane->NextTaskToDoIndex, &Position, Position + 1,
+				memory_order_relaxed, memory_order_relaxed))
+			{
+				// NOTE(ariel) Hand the slot to the producer one lap ahead.
+				*Task = Slot->Task;
+				atomic_store_explicit(&Slot->Sequence, Position + Mask + 1, memory_order_release);
+				return true;
+			}
+		}
+		else if (Difference < 0)
+		{
+			return false;
+		}
+		else
+		{
+			Position = atomic_load_explicit(&Lane->NextTaskToDoIndex, memory_order_relaxed);
+		}
+	}
+}
+
+static b32
+PeekQueuedTime(task_queue *Queue, task_lane *Lane, s64 *QueuedTime)
+{
+	// NOTE(ariel) Consumers may take the task while this thread looks at it, so
+	// the time is only a hint.
+	u64 Mask = (u64)Queue->MaxTaskCount - 1;
+	u64 Position = atomic_load_explicit(&Lane->NextTaskToDoIndex, memory_order_relaxed);
+	task_slot *Slot = &Lane->Slots[Position & Mask];
+	b32 Found = atomic_load_explicit(&Slot->Sequence, memory_order_acquire) == Position + 1;
+	if (Found)
+	{
+		*QueuedTime = atomic_load_explicit(&Slot->QueuedTime, memory_order_relaxed);
+	}
+	return Found;
+}
+
+static s32
+PickLane(task_queue *Queue)
+{
+	// NOTE(ariel) Give the oldest task of each lane a deadline that lies one
+	// aging period later for each step it sits below the most urgent lane, and
+	// pick the lane whose deadline comes first. A task therefore waits at most
+	// that long behind tasks added after it.
+	s32 PickedLane = 0;
+	s64 EarliestDeadline = INT64_MAX;
+	for (s32 Priority = 0; Priority < TASK_PRIORITY_COUNT; Priority += 1)
+	{
+		s64 QueuedTime = 0;
+		if (PeekQueuedTime(Queue, &Queue->Lanes[Priority], &QueuedTime))
+		{
+			s64 Deadline = QueuedTime + (s64)Priority*TASK_AGING_MICROSECONDS;
+			if (Deadline < EarliestDeadline)
+			{
+				EarliestDeadline = Deadline;
+				PickedLane = Priority;
+			}
+		}
+	}
+	return PickedLane;
+}
+
+static void
+PushTaskIntoFreeSlot(task_queue *Queue, task_lane *Lane, task_to_do Procedure, void *Data)
+{
+	// NOTE(ariel) The free slot this producer waited for may not be the next one
+	// in the ring if consumers finish out of order, but the next one frees soon.
+	while (!PushTask(Queue, Lane, Procedure, Data))
+	{
+		sched_yield();
+	}
+	WakeThread(Queue);
+}
+
+static b32
+PushTaskToCurrentThread(task_queue *Queue, task_to_do Procedure, void *Data)
+{
+	thread_info *Thread = CurrentThreadInfo;
+	b32 Pushed = Thread && Thread->TaskQueue == Queue && PushTaskToDeque(&Thread->Deque, Procedure, Data);
+	if (Pushed)
+	{
+		WakeThread(Queue);
+	}
+	return Pushed;
+}
+
+static void
+AddTaskToQueue(task_queue *Queue, task_priority Priority, task_to_do Procedure, void *Data)
+{
+	Assert(Priority < TASK_PRIORITY_COUNT);
+	if (!PushTaskToCurrentThread(Queue, Procedure, Data))
+	{
+		task_lane *Lane = &Queue->Lanes[Priority];
+		while (sem_wait(&Lane->FreeSlotSemaphore) != 0)
+		{
+			Assert(errno == EINTR);
+		}
+		PushTaskIntoFreeSlot(Queue, Lane, Procedure, Data);
+	}
+}
+
+static b32
+TryAddTaskToQueue(task_queue *Queue, task_priority Priority, task_to_do Procedure, void *Data)
+{
+	Assert(Priority < TASK_PRIORITY_COUNT);
+	b32 Added = PushTaskToCurrentThread(Queue, Procedure, Data);
+	if (!Added)
+	{
+		task_lane *Lane = &Queue->Lanes[Priority];
+		Added = sem_trywait(&Lane->FreeSlotSemaphore) == 0;
+		if (Added)
+		{
+			PushTaskIntoFreeSlot(Queue, Lane, Procedure, Data);
+		}
+	}
+	return Added;
+}
+
+static u64
+NextRandom(u64 *State)
+{
+	// NOTE(ariel) xorshift64 is plenty to pick victims.
+	u64 X = *State;
+	X ^= X << 13;
+	X ^= X >> 7;
+	X ^= X << 17;
+	*State = X;
+	return X;
+}
+
+static b32
+FindTask(task_queue *Queue, thread_info *Thread, task *Task)
+{
+	// NOTE(ariel) Prefer the tasks this thread added itself, since their data
+	// likely still sits in its cache, then tasks from outside of the pool, and
+	// only then steal from other workers, starting at a random one so that
+	// thieves spread out. Fall back to other lanes in case another worker
+	// empties the picked one first.
+	if (TakeTaskFromDeque(&Thread->Deque, Task))
+	{
+		return true;
+	}
+	s32 PickedLane = PickLane(Queue);
+	for (s32 Offset = 0; Offset < TASK_PRIORITY_COUNT; Offset += 1)
+	{
+		task_lane *Lane = &Queue->Lanes[(PickedLane + Offset) % TASK_PRIORITY_COUNT];
+		if (PopTask(Queue, Lane, Task))
+		{
+			sem_post(&Lane->FreeSlotSemaphore);
+			return true;
+		}
+	}
+
+	s32 ThreadCount = Queue->AdditionalThreadCount + 1;
+	s32 FirstVictim = (s32)(NextRandom(&Thread->RandomState) % (u64)ThreadCount);
+	for (s32 Offset = 0; Offset < ThreadCount; Offset += 1)
+	{
+		thread_info *Victim = &Queue->ThreadInfo[(FirstVictim + Offset) % ThreadCount];
+		if (Victim != Thread && StealTaskFromDeque(&Victim->Deque, Task))
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
-static inline b32
-SomeTaskToDoExists(task_queue *Queue)
+static b32
+TaskMayExist(task_queue *Queue)
 {
-	b32 Result = Queue->CompletedTaskCount != Queue->TotalTaskCount;
+	b32 Result = false;
+	for (s32 Priority = 0; !Result && Priority < TASK_PRIORITY_COUNT; Priority += 1)
+	{
+		task_lane *Lane = &Queue->Lanes[Priority];
+		Result = atomic_load(&Lane->NextTaskToAddIndex) != atomic_load(&Lane->NextTaskToDoIndex);
+	}
+	for (s32 Index = 0; !Result && Index <= Queue->AdditionalThreadCount; Index += 1)
+	{
+		task_deque *Deque = &Queue->ThreadInfo[Index].Deque;
+		Result = atomic_load(&Deque->Bottom) > atomic_load(&Deque->Top);
+	}
 	return Result;
 }
 
+static b32
+DoTask(task_queue *Queue, thread_info *Thread)
+{
+	b32 ThreadShouldSleep = true;
+
+	task Task = {0};
+	if (FindTask(Queue, Thread, &Task))
+	{
+		Task.Procedure(Thread->ID, Task.Data);
+		ThreadShouldSleep = false;
+	}
+
+	return ThreadShouldSleep;
+}
+
 static void *
 ThreadProcess(void *Argument)
 {
 	thread_info *Info = Argument;
+	task_queue *Queue = Info->TaskQueue;
+	CurrentThreadInfo = Info;
+	if (Info->PinnedCPU >= 0)
+	{
+		PinThreadToCPU(Info->PinnedCPU);
+	}
 
 	for (;;)
 	{
 		// NOTE(ariel) A thread should sleep when there doesn't exist work for it to
-		// do -- unless it's the main thread.
-		b32 ThreadShouldSleep = DoTask(Info->TaskQueue, Info->ID);
+		// do -- unless it's the main thread. Read the wake count before looking
+		// for work one last time, so that a producer that adds work after the look
+		// changes the count and the futex doesn't sleep.
+		b32 ThreadShouldSleep = DoTask(Queue, Info);
 		if (ThreadShouldSleep)
 		{
-			sem_wait(&Info->TaskQueue->Semaphore);
+			u32 WakeCount = atomic_load(&Queue->WakeCount);
+			atomic_fetch_add(&Queue->ParkedThreadCount, 1);
+			atomic_thread_fence(memory_order_seq_cst);
+			if (!TaskMayExist(Queue))
+			{
+				FutexWait(&Queue->WakeCount, WakeCount);
+			}
+			atomic_fetch_sub(&Queue->ParkedThreadCount, 1);
 		}
 	}
 
@@ -78,29 +451,72 @@ ThreadProcess(void *Argument)
 }
 
 static void
-InitializeThreads(arena *Arena, task_queue *Queue)
+DoTasksUntil(task_queue *Queue, s64 Deadline)
+{
+	// NOTE(ariel) The main thread only counts as a thread of the pool while it
+	// does tasks, so that tasks it adds otherwise go to the shared queue in
+	// order of priority rather than onto its deque.
+	thread_info *Info = &Queue->ThreadInfo[Queue->AdditionalThreadCount];
+	CurrentThreadInfo = Info;
+	while (GetMicroseconds() < Deadline)
+	{
+		b32 NoTaskRemains = DoTask(Queue, Info);
+		if (NoTaskRemains)
+		{
+			break;
+		}
+	}
+	CurrentThreadInfo = 0;
+}
+
+static void
+InitializeThreads(arena *Arena, task_queue *Queue, s32 ThreadCount, b32 PinThreads)
 {
 	s32 Status = 0; (void)Status;
 
-	s32 InitialValue = 0;
 	s32 YesShareSemaphoreOnlyBetweenThreads = 0;
-	Status = sem_init(&Queue->Semaphore, YesShareSemaphoreOnlyBetweenThreads, InitialValue);
-	Assert(Status == 0);
-
 	Assert(Queue->MaxTaskCount > 0);
-	Queue->Tasks = PushArrayToArena(Arena, task, Queue->MaxTaskCount);
+	s32 MaxTaskCount = 1;
+	while (MaxTaskCount < Queue->MaxTaskCount)
+	{
+		MaxTaskCount *= 2;
+	}
+	Queue->MaxTaskCount = MaxTaskCount;
+	for (s32 Priority = 0; Priority < TASK_PRIORITY_COUNT; Priority += 1)
+	{
+		task_lane *Lane = &Queue->Lanes[Priority];
+		Status = sem_init(&Lane->FreeSlotSemaphore, YesShareSemaphoreOnlyBetweenThreads, (u32)Queue->MaxTaskCount);
+		Assert(Status == 0);
+
+		Lane->Slots = PushArrayToArena(Arena, task_slot, Queue->MaxTaskCount);
+		for (s32 Index = 0; Index < Queue->MaxTaskCount; Index += 1)
+		{
+			atomic_init(&Lane->Slots[Index].Sequence, (u64)Index);
+		}
+	}
 
 	// NOTE(ariel) Thread management is sort of like memory management in that
 	// it's best -- faster for the machine and easier for the human -- to set
-	// it up eagerly ahead of time rather than lazily on demand.
+	// it up eagerly ahead of time rather than lazily on demand. Set up every
+	// deque before any thread starts to steal from them. Pinned threads start
+	// from the second core, which leaves the first to the main thread unless
+	// there are more threads than cores.
+	Assert(ThreadCount >= 0);
 	s32 CPUCoreCount = GetCPUCoreCount();
-	Queue->AdditionalThreadCount = CPUCoreCount - 1;
-	Queue->ThreadInfo = PushArrayToArena(Arena, thread_info, Queue->AdditionalThreadCount);
-	for (s32 Index = 0; Index < Queue->AdditionalThreadCount; Index += 1)
+	Queue->AdditionalThreadCount = ThreadCount;
+	Queue->ThreadInfo = PushArrayToArena(Arena, thread_info, Queue->AdditionalThreadCount + 1);
+	for (s32 Index = 0; Index <= Queue->AdditionalThreadCount; Index += 1)
 	{
 		thread_info *Info = &Queue->ThreadInfo[Index];
 		Info->TaskQueue = Queue;
 		Info->ID = Index;
+		Info->Deque.Tasks = PushArrayToArena(Arena, task, TASK_DEQUE_CAPACITY);
+		Info->RandomState = 0x9e3779b97f4a7c15ull * (u64)(Index + 1);
+		Info->PinnedCPU = PinThreads && Index < Queue->AdditionalThreadCount ? (Index + 1) % CPUCoreCount : -1;
+	}
+	for (s32 Index = 0; Index < Queue->AdditionalThreadCount; Index += 1)
+	{
+		thread_info *Info = &Queue->ThreadInfo[Index];
 		Status = pthread_create(&Info->PthreadLabel, 0, ThreadProcess, Info);
 		Status = pthread_detach(Info->PthreadLabel);
 		Assert(Status == 0);
@@ -11,27 +11,84 @@ struct task
 	void *Data;
 };
 
+// NOTE(ariel) Lanes of the shared queue from most to least urgent. Workers
+// take a task from the most urgent lane first, except that a task ages one
+// lane more urgent every `TASK_AGING_MICROSECONDS` it waits, so a steady
+// stream of urgent tasks never starves the rest.
+typedef u8 task_priority;
+enum
+{
+	TASK_PRIORITY_INTERACTIVE,
+	TASK_PRIORITY_VISIBLE,
+	TASK_PRIORITY_BACKGROUND,
+	TASK_PRIORITY_COUNT,
+};
+
+#define TASK_AGING_MICROSECONDS 250000
+
 // NOTE(ariel) Forward declare `thread_info` to access it from `task_queue`.
 typedef struct thread_info thread_info;
 
-// NOTE(ariel) Model single producer, multiple consumer.
-typedef struct task_queue task_queue;
-struct task_queue
+// NOTE(ariel) Each slot of the queue carries a sequence number that tells
+// producers and consumers whose turn it is to use it, as in Dmitry Vyukov's
+// bounded MPMC queue. A slot at position P is free for the producer that
+// claims position P once its sequence number equals P, and it holds a task for
+// the consumer that claims P once its sequence number equals P + 1.
+typedef struct task_slot task_slot;
+struct task_slot
 {
-	sem_t Semaphore;
+	_Atomic u64 Sequence;
+	_Atomic s64 QueuedTime;
+	task Task;
+};
 
-	_Atomic s32 CompletedTaskCount;
-	_Atomic s32 TotalTaskCount;
-	_Atomic s32 NextTaskToDoIndex;
-	_Atomic s32 NextTaskToAddIndex;
+// NOTE(ariel) Tasks that threads outside of the pool add go into a shared ring
+// buffer for their priority that never grows. Positions count up forever and
+// only wrap as indices into the ring, so the queue outlives any number of
+// tasks. Producers wait for a free slot when their lane's ring is full.
+typedef struct task_lane task_lane;
+struct task_lane
+{
+	sem_t FreeSlotSemaphore;
 
-	task *Tasks;
+	_Atomic u64 NextTaskToDoIndex;
+	_Atomic u64 NextTaskToAddIndex;
+
+	task_slot *Slots;
+};
+
+//
+// Tasks that workers add go onto their own deques instead, where they stay
+// local to the worker unless an idle worker steals them. Idle workers park on
+// a futex, and producers only wake one if some worker is parked.
+typedef struct task_queue task_queue;
+struct task_queue
+{
+	task_lane Lanes[TASK_PRIORITY_COUNT];
 	s32 MaxTaskCount;
 
+	_Atomic u32 WakeCount;
+	_Atomic s32 ParkedThreadCount;
+
+	// NOTE(ariel) `ThreadInfo` holds one entry for each additional thread and
+	// one last entry for the main thread.
 	thread_info *ThreadInfo;
 	s32 AdditionalThreadCount;
 };
 
+// NOTE(ariel) A Chase-Lev deque with a fixed capacity. Only its worker pushes
+// and takes tasks at the bottom, last in first out, while any worker may steal
+// tasks from the top, first in first out.
+enum { TASK_DEQUE_CAPACITY = 256 };
+
+typedef struct task_deque task_deque;
+struct task_deque
+{
+	_Atomic s64 Top;
+	_Atomic s64 Bottom;
+	task *Tasks;
+};
+
 typedef struct thread_info thread_info;
 struct thread_info
 {
@@ -41,15 +98,33 @@ struct thread_info
 	pthread_t PthreadLabel;
 	task_queue *TaskQueue;
 
+	task_deque Deque;
+	u64 RandomState;
+	s32 PinnedCPU;
+
 	// NOTE(ariel) Each thread may also maintain access to custom fields for each
 	// individual program.
-	CURL *CurlHandle;
 	arena ScratchArena;
 	arena PersistentArena;
 };
 
-// NOTE(ariel) To maintain thread safety, only the main thread should call
-// AddTaskToQueue() and CompleteTasks().
-static void AddTaskToQueue(task_queue *Queue, task_to_do Procedure, void *Data);
+// NOTE(ariel) Any thread may add tasks. A worker adds tasks to its own deque
+// until it fills and then to the shared queue like any other thread. Tasks on
+// a deque belong to work already under way, so they ignore their priority.
+// AddTaskToQueue() waits for a free slot if the lane is full, while
+// TryAddTaskToQueue() returns false instead. A task that adds more tasks should
+// try to add them and do the work itself if they don't fit, since a worker
+// waiting on the queue can't empty it. InitializeThreads() rounds
+// `MaxTaskCount`, the capacity of each lane, up to a power of two.
+static void AddTaskToQueue(task_queue *Queue, task_priority Priority, task_to_do Procedure, void *Data);
+static b32 TryAddTaskToQueue(task_queue *Queue, task_priority Priority, task_to_do Procedure, void *Data);
+
+// NOTE(ariel) InitializeThreads() starts `ThreadCount` additional threads,
+// possibly none, and pins each to its own core if asked. The main thread does
+// tasks only when it calls DoTasksUntil(), which returns once no task remains
+// or the clock of GetMicroseconds() reaches the deadline. It checks the
+// deadline between tasks, so a long task may run past it.
+static void InitializeThreads(arena *Arena, task_queue *Queue, s32 ThreadCount, b32 PinThreads);
+static void DoTasksUntil(task_queue *Queue, s64 Deadline);
 
 #endif
@@ -1,20 +1,317 @@
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* ---
- * Parser
+ * Byte Scanning
+ * ---
+ */
+
+// NOTE(ariel) These kernels return the offset of the first match at or after
+// `offset` or `s.len` if no match exists. They compare 32 bytes at a time with
+// AVX2, 16 bytes at a time with SSE2, and finish the tail one byte at a time.
+
+static s32
+scan_for_char(string s, s32 offset, char c)
+{
+	s32 index = offset;
+
+#if defined(__AVX2__)
+	__m256i c32 = _mm256_set1_epi8(c);
+	for (; index + 32 <= s.len; index += 32)
+	{
+		__m256i chunk = _mm256_loadu_si256((__m256i *)(s.str + index));
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, c32));
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	__m128i c16 = _mm_set1_epi8(c);
+	for (; index + 16 <= s.len; index += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((__m128i *)(s.str + index));
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, c16));
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	while (index < s.len && s.str[index] != c)
+	{
+		++index;
+	}
+	return index;
+}
+
+static s32
+scan_for_either_char(string s, s32 offset, char a, char b)
+{
+	s32 index = offset;
+
+#if defined(__AVX2__)
+	__m256i a32 = _mm256_set1_epi8(a);
+	__m256i b32 = _mm256_set1_epi8(b);
+	for (; index + 32 <= s.len; index += 32)
+	{
+		__m256i chunk = _mm256_loadu_si256((__m256i *)(s.str + index));
+		__m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, a32), _mm256_cmpeq_epi8(chunk, b32));
+		u32 mask = (u32)_mm256_movemask_epi8(match);
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	__m128i a16 = _mm_set1_epi8(a);
+	__m128i b16 = _mm_set1_epi8(b);
+	for (; index + 16 <= s.len; index += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((__m128i *)(s.str + index));
+		__m128i match = _mm_or_si128(_mm_cmpeq_epi8(chunk, a16), _mm_cmpeq_epi8(chunk, b16));
+		u32 mask = (u32)_mm_movemask_epi8(match);
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	while (index < s.len && s.str[index] != a && s.str[index] != b)
+	{
+		++index;
+	}
+	return index;
+}
+
+static s32
+scan_for_tag_delimiter(string s, s32 offset)
+{
+	s32 index = offset;
+
+	// NOTE(ariel) Find the end of a start tag or the start of a quoted attribute
+	// value, which may itself contain '/' or '>'.
+#if defined(__AVX2__)
+	__m256i slash32 = _mm256_set1_epi8('/');
+	__m256i angle32 = _mm256_set1_epi8('>');
+	__m256i double32 = _mm256_set1_epi8('"');
+	__m256i single32 = _mm256_set1_epi8('\'');
+	for (; index + 32 <= s.len; index += 32)
+	{
+		__m256i chunk = _mm256_loadu_si256((__m256i *)(s.str + index));
+		__m256i match = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, slash32), _mm256_cmpeq_epi8(chunk, angle32)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, double32), _mm256_cmpeq_epi8(chunk, single32)));
+		u32 mask = (u32)_mm256_movemask_epi8(match);
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	__m128i slash16 = _mm_set1_epi8('/');
+	__m128i angle16 = _mm_set1_epi8('>');
+	__m128i double16 = _mm_set1_epi8('"');
+	__m128i single16 = _mm_set1_epi8('\'');
+	for (; index + 16 <= s.len; index += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((__m128i *)(s.str + index));
+		__m128i match = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, slash16), _mm_cmpeq_epi8(chunk, angle16)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, double16), _mm_cmpeq_epi8(chunk, single16)));
+		u32 mask = (u32)_mm_movemask_epi8(match);
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	while (index < s.len)
+	{
+		char c = s.str[index];
+		if (c == '/' || c == '>' || c == '"' || c == '\'')
+		{
+			break;
+		}
+		++index;
+	}
+	return index;
+}
+
+static s32
+scan_past_whitespace(string s, s32 offset)
+{
+	s32 index = offset;
+
+	// NOTE(ariel) Runs of whitespace between tags tend to be short, so 16 bytes
+	// at a time suffices here.
+#if defined(__SSE2__)
+	__m128i space = _mm_set1_epi8(' ');
+	__m128i line = _mm_set1_epi8('\n');
+	__m128i tab = _mm_set1_epi8('\t');
+	__m128i ret = _mm_set1_epi8('\r');
+	for (; index + 16 <= s.len; index += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((__m128i *)(s.str + index));
+		__m128i whitespace = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, line)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, tab), _mm_cmpeq_epi8(chunk, ret)));
+		u32 mask = ~(u32)_mm_movemask_epi8(whitespace) & 0xffff;
+		if (mask)
+		{
+			return index + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	while (index < s.len)
+	{
+		char c = s.str[index];
+		if (c != ' ' && c != '\n' && c != '\t' && c != '\r')
+		{
+			break;
+		}
+		++index;
+	}
+	return index;
+}
+
+static s32
+scan_for_string(string s, s32 offset, string needle)
+{
+	assert(needle.len > 0);
+	s32 index = offset;
+	s32 last = needle.len - 1;
+
+	// NOTE(ariel) Compare the first and last bytes of the needle against each
+	// candidate position at once and only confirm candidates with both bytes in
+	// place. Terminators like "]]>" and "-->" rarely appear in content, so
+	// almost no candidates survive to the full comparison.
+#if defined(__AVX2__)
+	__m256i first32 = _mm256_set1_epi8(needle.str[0]);
+	__m256i last32 = _mm256_set1_epi8(needle.str[last]);
+	for (; index + last + 32 <= s.len; index += 32)
+	{
+		__m256i head = _mm256_loadu_si256((__m256i *)(s.str + index));
+		__m256i tail = _mm256_loadu_si256((__m256i *)(s.str + index + last));
+		__m256i match = _mm256_and_si256(_mm256_cmpeq_epi8(head, first32), _mm256_cmpeq_epi8(tail, last32));
+		u32 mask = (u32)_mm256_movemask_epi8(match);
+		while (mask)
+		{
+			s32 candidate = index + __builtin_ctz(mask);
+			if (memcmp(s.str + candidate, needle.str, needle.len) == 0)
+			{
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	__m128i first16 = _mm_set1_epi8(needle.str[0]);
+	__m128i last16 = _mm_set1_epi8(needle.str[last]);
+	for (; index + last + 16 <= s.len; index += 16)
+	{
+		__m128i head = _mm_loadu_si128((__m128i *)(s.str + index));
+		__m128i tail = _mm_loadu_si128((__m128i *)(s.str + index + last));
+		__m128i match = _mm_and_si128(_mm_cmpeq_epi8(head, first16), _mm_cmpeq_epi8(tail, last16));
+		u32 mask = (u32)_mm_movemask_epi8(match);
+		while (mask)
+		{
+			s32 candidate = index + __builtin_ctz(mask);
+			if (memcmp(s.str + candidate, needle.str, needle.len) == 0)
+			{
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for (; index + last < s.len; ++index)
+	{
+		if (memcmp(s.str + index, needle.str, needle.len) == 0)
+		{
+			return index;
+		}
+	}
+	return s.len;
+}
+
+
+/* ---
+ * Names
  * ---
  */
 
-typedef struct Parser Parser;
-struct Parser
+#define RSS_NAME_HASH(length, first, last) (((length) + 2*(first) + 51*(last)) & 127)
+
+global RSS_Name_ID name_table[128] =
 {
-	arena *Arena;
-	RSS_Tree *tree;
-	RSS_Tree_Node *current_node;
-	string source;
-	s32 cursor;
+#define RSS_NAME(id, text, first, last) [RSS_NAME_HASH(sizeof(text) - 1, first, last)] = RSS_NAME_##id,
+	RSS_NAMES
+#undef RSS_NAME
 };
 
+global string name_strings[RSS_NAME_COUNT] =
+{
+#define RSS_NAME(id, text, first, last) [RSS_NAME_##id] = static_string_literal(text),
+	RSS_NAMES
+#undef RSS_NAME
+};
+
+static RSS_Name_ID
+classify_name(string name)
+{
+	RSS_Name_ID name_id = RSS_NAME_UNKNOWN;
+
+	if (name.len > 0)
+	{
+		u8 first = (u8)name.str[0];
+		u8 last = (u8)name.str[name.len - 1];
+		RSS_Name_ID candidate = name_table[RSS_NAME_HASH((u32)name.len, first, last)];
+		if (candidate && string_match(name, name_strings[candidate]))
+		{
+			name_id = candidate;
+		}
+	}
+
+	return name_id;
+}
+
+static string
+name_of_id(RSS_Name_ID name_id)
+{
+	assert(name_id < RSS_NAME_COUNT);
+	string name = name_strings[name_id];
+	return name;
+}
+
+static inline b32
+is_item_name(RSS_Name_ID name_id)
+{
+	// NOTE(ariel) RSS uses the keyword "item". Atom uses the keyword "entry".
+	b32 result = name_id == RSS_NAME_ITEM || name_id == RSS_NAME_ENTRY;
+	return result;
+}
+
+
+/* ---
+ * Parser
+ * ---
+ */
+
 static void
-error(Parser *parser, string message)
+error(RSS_Parser *parser, string message)
 {
 	RSS_Error *e = PushStructToArena(parser->Arena, RSS_Error);
 	e->next = 0;
@@ -36,7 +333,7 @@ error(Parser *parser, string message)
 }
 
 static char
-peek_char(Parser *parser)
+peek_char(RSS_Parser *parser)
 {
 	char ch = 0;
 	if (parser->cursor < parser->source.len)
@@ -68,28 +365,14 @@ is_name_char(char c)
 	return result;
 }
 
-static b32
-is_whitespace(char c)
-{
-	b32 space = c == ' ';
-	b32 line = c == '\n';
-	b32 tab = c == '\t';
-	b32 ret = c == '\r';
-	b32 result = space | line | tab | ret;
-	return result;
-}
-
 static void
-skip_whitespace(Parser *parser)
+skip_whitespace(RSS_Parser *parser)
 {
-	while (is_whitespace(peek_char(parser)))
-	{
-		++parser->cursor;
-	}
+	parser->cursor = scan_past_whitespace(parser->source, parser->cursor);
 }
 
 static b32
-accept_char(Parser *parser, char c)
+accept_char(RSS_Parser *parser, char c)
 {
 	b32 accept = false;
 	if (c == peek_char(parser))
@@ -101,7 +384,7 @@ accept_char(Parser *parser, char c)
 }
 
 static b32
-accept_string(Parser *parser, string s)
+accept_string(RSS_Parser *parser, string s)
 {
 	b32 accept = false;
 
@@ -123,7 +406,7 @@ accept_string(Parser *parser, string s)
 }
 
 static string
-expect_name(Parser *parser)
+expect_name(RSS_Parser *parser)
 {
 	string s = {0};
 
@@ -148,25 +431,20 @@ expect_name(Parser *parser)
 }
 
 static void
-continue_to_char(Parser *parser, char c)
+continue_to_char(RSS_Parser *parser, char c)
 {
-	while (parser->cursor < parser->source.len && c != parser->source.str[parser->cursor])
-	{
-		++parser->cursor;
-	}
+	parser->cursor = scan_for_char(parser->source, parser->cursor, c);
 }
 
 static void
-continue_past_string(Parser *parser, string s)
+continue_past_string(RSS_Parser *parser, string s)
 {
-	while (parser->cursor < parser->source.len && !accept_string(parser, s))
-	{
-		++parser->cursor;
-	}
+	s32 offset = scan_for_string(parser->source, parser->cursor, s);
+	parser->cursor = MIN(offset + s.len, parser->source.len);
 }
 
 static void
-push_rss_node(Parser *parser)
+push_rss_node(RSS_Parser *parser)
 {
 	if (!parser->current_node)
 	{
@@ -204,120 +482,396 @@ push_rss_node(Parser *parser)
 }
 
 static void
-pop_rss_node(Parser *parser)
+pop_rss_node(RSS_Parser *parser)
 {
 	parser->current_node = parser->current_node->parent;
 }
 
+static RSS_Attribute_Iterator
+iterate_attributes(string attributes)
+{
+	RSS_Attribute_Iterator iterator = {0};
+	iterator.source = attributes;
+	return iterator;
+}
+
+static b32
+next_attribute(RSS_Attribute_Iterator *iterator, RSS_Attribute *attribute)
+{
+	b32 found = false;
+
+	string source = iterator->source;
+	s32 cursor = scan_past_whitespace(source, iterator->cursor);
+
+	s32 name_start = cursor;
+	while (cursor < source.len && is_name_char(source.str[cursor]))
+	{
+		++cursor;
+	}
+	string name = {source.str + name_start, cursor - name_start};
+
+	cursor = scan_past_whitespace(source, cursor);
+	if (name.len > 0 && cursor < source.len && source.str[cursor] == '=')
+	{
+		cursor = scan_past_whitespace(source, cursor + 1);
+		if (cursor < source.len && (source.str[cursor] == '"' || source.str[cursor] == '\''))
+		{
+			s32 value_start = cursor + 1;
+			cursor = scan_for_char(source, value_start, source.str[cursor]);
+			if (cursor < source.len)
+			{
+				attribute->name_id = classify_name(name);
+				attribute->name = name;
+				attribute->value.str = source.str + value_start;
+				attribute->value.len = cursor - value_start;
+				cursor += 1;
+				found = true;
+			}
+		}
+	}
+
+	// NOTE(ariel) Stop for good at anything that isn't a name followed by a
+	// quoted value rather than guess where the next attribute starts.
+	iterator->cursor = found ? cursor : source.len;
+	return found;
+}
+
+static string
+find_attribute(string attributes, RSS_Name_ID name_id)
+{
+	string value = {0};
+
+	RSS_Attribute attribute = {0};
+	RSS_Attribute_Iterator iterator = iterate_attributes(attributes);
+	while (next_attribute(&iterator, &attribute))
+	{
+		if (attribute.name_id == name_id)
+		{
+			value = attribute.value;
+			break;
+		}
+	}
+
+	return value;
+}
+
+static string
+choose_link(string content, string attributes)
+{
+	string link = {0};
+
+	if (content.len > 0)
+	{
+		link = content;
+	}
+	else
+	{
+		b32 type_equals_html = false;
+		b32 rel_equals_alternate = false;
+		string href = {0};
+		RSS_Attribute attr = {0};
+		RSS_Attribute_Iterator iterator = iterate_attributes(attributes);
+		while (next_attribute(&iterator, &attr))
+		{
+			if (attr.name_id == RSS_NAME_HREF)
+			{
+				href = attr.value;
+			}
+			else if (attr.name_id == RSS_NAME_REL)
+			{
+				rel_equals_alternate = string_match(attr.value, string_literal("alternate"));
+			}
+			else if (attr.name_id == RSS_NAME_TYPE)
+			{
+				type_equals_html = string_match(attr.value, string_literal("text/html"));
+			}
+
+			if (rel_equals_alternate && type_equals_html && href.str)
+			{
+				link = href;
+				break;
+			}
+		}
+
+		if (!link.str && href.str)
+		{
+			// NOTE(ariel) Choose any link if no tag strictly matches the
+			// requirements above.
+			link = href;
+		}
+	}
+
+	return link;
+}
+
+enum
+{
+	RSS_ITEM_HAS_TITLE   = 1 << 0,
+	RSS_ITEM_HAS_LINK    = 1 << 1,
+	RSS_ITEM_HAS_PUBDATE = 1 << 2,
+	RSS_ITEM_HAS_UPDATED = 1 << 3,
+};
+
+// NOTE(ariel) The following functions extract the same feed title and items
+// that a walk of the tree finds -- the first title element in the document,
+// and the title, link, and date of the first item and any items that follow
+// it under the same parent -- but they track only a stack of open elements.
 static void
-continue_past_end_of_tag(Parser *parser)
+open_element(RSS_Parser *parser, string name, RSS_Name_ID name_id, string attributes)
 {
-	while (parser->cursor < parser->source.len)
+	parser->depth += 1;
+	if (parser->depth > RSS_MAX_ELEMENT_DEPTH)
+	{
+		// NOTE(ariel) Rather than drop elements it can't track, fail the parse
+		// so that the feed never loses items without a word.
+		error(parser, string_literal("depth of element exceeds maximum"));
+	}
+	else
 	{
-		char c = parser->source.str[parser->cursor++];
-		if (c == '/')
+		RSS_Element *element = &parser->elements[parser->depth - 1];
+		element->name_id = name_id;
+		element->name = name;
+		element->content.str = 0;
+		element->content.len = 0;
+		element->attributes = attributes;
+
+		if (!parser->found_feed_title && !parser->feed_title_depth && name_id == RSS_NAME_TITLE)
+		{
+			parser->feed_title_depth = parser->depth;
+		}
+
+		if (is_item_name(name_id))
 		{
-			if (parser->cursor < parser->source.len)
+			if (!parser->item_depth)
 			{
-				c = parser->source.str[parser->cursor++];
-				if (c == '>')
+				parser->item_depth = parser->depth;
+			}
+			if (parser->depth == parser->item_depth && !parser->items_ended)
+			{
+				parser->in_item = true;
+				parser->item_fields = 0;
+				ZeroStruct(&parser->item);
+			}
+		}
+	}
+}
+
+static void
+close_item_child(RSS_Parser *parser, RSS_Element *child)
+{
+	RSS_Item *item = &parser->item;
+	switch (child->name_id)
+	{
+		case RSS_NAME_TITLE:
+		{
+			if (!(parser->item_fields & RSS_ITEM_HAS_TITLE))
+			{
+				item->title = child->content;
+				parser->item_fields |= RSS_ITEM_HAS_TITLE;
+			}
+		} break;
+		case RSS_NAME_LINK:
+		{
+			if (!(parser->item_fields & RSS_ITEM_HAS_LINK))
+			{
+				item->link = choose_link(child->content, child->attributes);
+				parser->item_fields |= RSS_ITEM_HAS_LINK;
+			}
+		} break;
+		case RSS_NAME_PUB_DATE:
+		{
+			// NOTE(ariel) Prefer the date an item was last updated over the date it
+			// was published.
+			if (!(parser->item_fields & (RSS_ITEM_HAS_PUBDATE | RSS_ITEM_HAS_UPDATED)))
+			{
+				item->date = child->content;
+			}
+			parser->item_fields |= RSS_ITEM_HAS_PUBDATE;
+		} break;
+		case RSS_NAME_UPDATED:
+		{
+			if (!(parser->item_fields & RSS_ITEM_HAS_UPDATED))
+			{
+				item->date = child->content;
+			}
+			parser->item_fields |= RSS_ITEM_HAS_UPDATED;
+		} break;
+	}
+}
+
+static b32
+is_refresh_hint(RSS_Name_ID name_id, RSS_Name_ID parent_name_id)
+{
+	b32 result =
+		name_id == RSS_NAME_TTL ||
+		name_id == RSS_NAME_SY_UPDATE_PERIOD ||
+		name_id == RSS_NAME_SY_UPDATE_FREQUENCY ||
+		(name_id == RSS_NAME_HOUR && parent_name_id == RSS_NAME_SKIP_HOURS);
+	return result;
+}
+
+static void
+close_element(RSS_Parser *parser)
+{
+	if (parser->depth > 0 && parser->depth <= RSS_MAX_ELEMENT_DEPTH)
+	{
+		RSS_Element *element = &parser->elements[parser->depth - 1];
+		RSS_Handlers *handlers = parser->handlers;
+
+		RSS_Name_ID parent_name_id = parser->depth > 1 ? parser->elements[parser->depth - 2].name_id : RSS_NAME_UNKNOWN;
+		if (handlers->refresh_hint && is_refresh_hint(element->name_id, parent_name_id))
+		{
+			b32 inside_item = false;
+			for (s32 depth = 1; depth < parser->depth; ++depth)
+			{
+				inside_item |= is_item_name(parser->elements[depth - 1].name_id);
+			}
+			if (!inside_item)
+			{
+				handlers->refresh_hint(handlers->user_data, element->name_id, element->content);
+			}
+		}
+
+		if (parser->feed_title_depth == parser->depth)
+		{
+			parser->found_feed_title = true;
+			parser->feed_title_depth = 0;
+			if (handlers->feed_title)
+			{
+				handlers->feed_title(handlers->user_data, element->content);
+			}
+		}
+
+		if (parser->in_item)
+		{
+			if (parser->depth == parser->item_depth + 1)
+			{
+				close_item_child(parser, element);
+			}
+			else if (parser->depth == parser->item_depth)
+			{
+				parser->in_item = false;
+				if (handlers->item)
 				{
-					pop_rss_node(parser);
-					return;
+					handlers->item(handlers->user_data, &parser->item);
 				}
 			}
 		}
-		else if (c == '>')
+
+		if (parser->depth == parser->item_depth - 1)
 		{
-			return;
+			parser->items_ended = true;
 		}
 	}
+
+	parser->depth = MAX(parser->depth - 1, 0);
 }
 
-static b32
-expect_char(Parser *parser, char c)
+static void
+push_element(RSS_Parser *parser, string name, RSS_Name_ID name_id, string attributes)
 {
-	b32 expected = false;
-	if (c == peek_char(parser))
+	if (parser->handlers)
 	{
-		++parser->cursor;
-		expected = true;
+		open_element(parser, name, name_id, attributes);
 	}
 	else
 	{
-		error(parser, string_literal("encountered unexpected character"));
+		push_rss_node(parser);
+		parser->current_node->name_id = name_id;
+		parser->current_node->name = name;
+		parser->current_node->attributes = attributes;
 	}
-	return expected;
 }
 
-static string
-expect_string_literal(Parser *parser)
+static void
+pop_element(RSS_Parser *parser)
 {
-	string s = {0};
-
-	char quote = peek_char(parser);
-	if (quote == '"' || quote == '\'')
+	if (parser->handlers)
 	{
-		expect_char(parser, quote);
-		s32 start = parser->cursor;
-		continue_to_char(parser, quote);
-		s.str = parser->source.str + start;
-		s.len = parser->cursor - start;
-		expect_char(parser, quote);
+		close_element(parser);
 	}
 	else
 	{
-		error(parser, string_literal("expected single or double quote for string literal"));
+		pop_rss_node(parser);
 	}
+}
 
-	return s;
+static void
+set_element_content(RSS_Parser *parser, string content)
+{
+	if (parser->handlers)
+	{
+		if (parser->depth > 0 && parser->depth <= RSS_MAX_ELEMENT_DEPTH)
+		{
+			parser->elements[parser->depth - 1].content = content;
+		}
+	}
+	else
+	{
+		parser->current_node->content = content;
+	}
 }
 
-static RSS_Attribute *
-accept_attributes(Parser *parser)
+// NOTE(ariel) Store the raw text between the name of a start tag and its end
+// in `attributes` if given and return whether the tag closes itself.
+static b32
+continue_past_end_of_tag(RSS_Parser *parser, string *attributes)
 {
-	RSS_Attribute *attributes = 0;
+	b32 self_closing = false;
 
-	for (;;)
+	string source = parser->source;
+	s32 start = parser->cursor;
+	s32 end = source.len;
+	while (parser->cursor < source.len)
 	{
-		skip_whitespace(parser);
-		if (parser->cursor >= parser->source.len || parser->tree->errors.first)
+		s32 index = scan_for_tag_delimiter(source, parser->cursor);
+		if (index == source.len)
 		{
+			parser->cursor = source.len;
 			break;
 		}
 
-		char c = peek_char(parser);
-		if (c == '/' || c == '>')
+		char c = source.str[index];
+		if (c == '"' || c == '\'')
 		{
+			parser->cursor = MIN(scan_for_char(source, index + 1, c) + 1, source.len);
+		}
+		else if (c == '>')
+		{
+			end = index;
+			parser->cursor = index + 1;
 			break;
 		}
-
-		RSS_Attribute *attribute = PushStructToArena(parser->Arena, RSS_Attribute);
-		attribute->name = expect_name(parser);
-		expect_char(parser, '=');
-		attribute->value = expect_string_literal(parser);
-
-		if (attributes)
+		else if (index + 1 < source.len && source.str[index + 1] == '>')
 		{
-			attribute->next = attributes;
+			end = index;
+			parser->cursor = index + 2;
+			self_closing = true;
+			break;
 		}
 		else
 		{
-			attribute->next = 0;
+			parser->cursor = index + 1;
 		}
-		attributes = attribute;
 	}
 
-	return attributes;
+	if (attributes)
+	{
+		attributes->str = source.str + start;
+		attributes->len = end - start;
+	}
+
+	return self_closing;
 }
 
 static void
-parse_tree(Parser *parser)
+parse_tree(RSS_Parser *parser)
 {
+	s32 end = parser->end ? MIN(parser->end, parser->source.len) : parser->source.len;
 	for (;;)
 	{
 		skip_whitespace(parser);
-		if (parser->cursor >= parser->source.len || parser->tree->errors.first)
+		if (parser->cursor >= end || parser->tree->errors.first)
 		{
 			break;
 		}
@@ -326,7 +880,12 @@ parse_tree(Parser *parser)
 		{
 			if (accept_char(parser, '/'))
 			{
-				pop_rss_node(parser);
+				if (parser->range_root && parser->current_node == parser->range_root)
+				{
+					parser->cursor -= 2;
+					break;
+				}
+				pop_element(parser);
 				continue_past_string(parser, string_literal(">"));
 			}
 			else if (accept_char(parser, '!'))
@@ -336,8 +895,12 @@ parse_tree(Parser *parser)
 					s32 start = parser->cursor;
 					string cdend = string_literal("]]>");
 					continue_past_string(parser, cdend);
-					parser->current_node->content.str = parser->source.str + start;
-					parser->current_node->content.len = parser->cursor - start - cdend.len;
+					string content =
+					{
+						.str = parser->source.str + start,
+						.len = parser->cursor - start - cdend.len,
+					};
+					set_element_content(parser, content);
 				}
 				else if (accept_string(parser, string_literal("--")))
 				{
@@ -345,7 +908,7 @@ parse_tree(Parser *parser)
 				}
 				else if (accept_string(parser, string_literal("DOCTYPE")))
 				{
-					continue_past_end_of_tag(parser);
+					continue_past_end_of_tag(parser, 0);
 				}
 			}
 			else if (accept_char(parser, '?'))
@@ -354,21 +917,27 @@ parse_tree(Parser *parser)
 			}
 			else
 			{
-				push_rss_node(parser);
-				parser->current_node->name = expect_name(parser);
-				if(string_find_substr(parser->current_node->name, string_literal("link")) != -1)
+				string name = expect_name(parser);
+				RSS_Name_ID name_id = classify_name(name);
+				string attributes = {0};
+				b32 self_closing = continue_past_end_of_tag(parser, &attributes);
+				push_element(parser, name, name_id, attributes);
+				if (self_closing)
 				{
-					parser->current_node->attributes = accept_attributes(parser);
+					pop_element(parser);
 				}
-				continue_past_end_of_tag(parser);
 			}
 		}
 		else
 		{
 			s32 start = parser->cursor;
 			continue_to_char(parser, '<');
-			parser->current_node->content.str = parser->source.str + start;
-			parser->current_node->content.len = parser->cursor - start;
+			string content =
+			{
+				.str = parser->source.str + start,
+				.len = parser->cursor - start,
+			};
+			set_element_content(parser, content);
 		}
 	}
 }
@@ -383,32 +952,21 @@ RSS_PrintTreeRecursively(RSS_Tree_Node *Node, s8 Layer, FILE *Stream)
 		{
 			putc('\t', Stream);
 		}
-		if(Node->attributes)
+		fprintf(Stream, "[%.*s]", Node->name.len, Node->name.str);
+		RSS_Attribute Attribute = {0};
+		RSS_Attribute_Iterator Iterator = iterate_attributes(Node->attributes);
+		while(next_attribute(&Iterator, &Attribute))
 		{
-			fprintf(Stream, "[%.*s]", Node->name.len, Node->name.str);
-			for(RSS_Attribute *AttributeNode = Node->attributes; AttributeNode; AttributeNode = AttributeNode->next)
-			{
-				fprintf(Stream, " (%.*s=%.*s)",
-					AttributeNode->name.len, AttributeNode->name.str,
-					AttributeNode->value.len, AttributeNode->value.str);
-			}
-			if(Node->content.str)
-			{
-				string Content = string_trim_spaces(Node->content);
-				fprintf(Stream, " %.*s", Content.len, Content.str);
-			}
-			fprintf(Stream, "\n");
+			fprintf(Stream, " (%.*s=%.*s)",
+				Attribute.name.len, Attribute.name.str,
+				Attribute.value.len, Attribute.value.str);
 		}
-		else
+		if(Node->content.str)
 		{
-			fprintf(Stream, "[%.*s]", Node->name.len, Node->name.str);
-			if(Node->content.str)
-			{
-				string Content = string_trim_spaces(Node->content);
-				fprintf(Stream, " %.*s", Content.len, Content.str);
-			}
-			fprintf(Stream, "\n");
+			string Content = string_trim_spaces(Node->content);
+			fprintf(Stream, " %.*s", Content.len, Content.str);
 		}
+		fprintf(Stream, "\n");
 		RSS_PrintTreeRecursively(Node->first_child, Layer + 1, Stream);
 		Node = Node->next_sibling;
 	}
@@ -419,20 +977,213 @@ RSS_PrintTree(RSS_Tree *tree, FILE *stream)
 {
 	RSS_PrintTreeRecursively(tree->root, 0, stream);
 }
+
 #endif
 
+static void
+begin_parse_rss(RSS_Parser *parser, arena *Arena)
+{
+	ZeroStruct(parser);
+	parser->Arena = Arena;
+	parser->tree = PushStructToArena(Arena, RSS_Tree);
+}
+
+static RSS_Tree *
+finish_parse_rss(RSS_Parser *parser, string source)
+{
+	parser->source = source;
+	parse_tree(parser);
+	assert(parser->cursor == parser->source.len);
+	return parser->tree;
+}
+
 static RSS_Tree *
 parse_rss(arena *Arena, string source)
 {
-	Parser parser =
+	RSS_Parser parser = {0};
+	begin_parse_rss(&parser, Arena);
+	RSS_Tree *tree = finish_parse_rss(&parser, source);
+	return tree;
+}
+
+static RSS_Tree *
+extract_rss(arena *Arena, string source, RSS_Handlers *handlers)
+{
+	RSS_Parser parser = {0};
+	begin_parse_rss(&parser, Arena);
+	parser.handlers = handlers;
+	RSS_Tree *tree = finish_parse_rss(&parser, source);
+	return tree;
+}
+
+
+/* ---
+ * Parallel Parsing
+ * ---
+ */
+
+static s32
+find_start_tag(string source, s32 offset, string open)
+{
+	for (;;)
+	{
+		offset = scan_for_string(source, offset, open);
+		if (offset + open.len >= source.len)
+		{
+			offset = source.len;
+			break;
+		}
+
+		char c = source.str[offset + open.len];
+		if (c == '>' || c == '/' || c == ' ' || c == '\n' || c == '\t' || c == '\r')
+		{
+			break;
+		}
+		offset += 1;
+	}
+	return offset;
+}
+
+static RSS_Range_List
+split_rss(arena *Arena, string source, s32 max_range_count)
+{
+	RSS_Range_List list = {0};
+
+	// NOTE(ariel) These boundaries are only guesses. They may fall in a comment,
+	// CDATA, or an attribute value, or they may begin items nested deeper than
+	// the first, in which case the stitch below parses the range serially.
+	string open = string_literal("<item");
+	s32 first_item = find_start_tag(source, 0, open);
+	s32 first_entry = find_start_tag(string_prefix(source, first_item), 0, string_literal("<entry"));
+	if (first_entry < first_item)
 	{
-		.Arena = Arena,
-		.source = source,
-		.tree = PushStructToArena(Arena, RSS_Tree),
-	};
+		open = string_literal("<entry");
+		first_item = first_entry;
+	}
+
+	list.ranges = PushArrayToArena(Arena, RSS_Range, MAX(max_range_count, 1));
+	s32 begin = first_item;
+	for (s32 index = 1; index <= max_range_count && begin < source.len; index += 1)
+	{
+		s32 end = source.len;
+		if (index < max_range_count)
+		{
+			s32 target = first_item + (s32)((s64)(source.len - first_item) * index / max_range_count);
+			end = find_start_tag(source, MAX(target, begin + 1), open);
+		}
+
+		RSS_Range *range = &list.ranges[list.count++];
+		range->source = source;
+		range->begin = begin;
+		range->end = end;
+		begin = end;
+	}
+
+	return list;
+}
+
+static void
+parse_rss_range(RSS_Range *range)
+{
+	InitializeArena(&range->Arena);
+
+	RSS_Parser parser = {0};
+	begin_parse_rss(&parser, &range->Arena);
+	parser.range_root = parser.current_node = PushStructToArena(&range->Arena, RSS_Tree_Node);
+	parser.source = range->source;
+	parser.cursor = range->begin;
+
+	// NOTE(ariel) The parser sees the whole source, so it parses any token that
+	// crosses into the next range as the serial parse does. Such a token proves
+	// the next range begins at a false boundary.
+	parser.end = range->end;
 	parse_tree(&parser);
-	assert(parser.cursor == parser.source.len);
-	return parser.tree;
+
+	range->root = parser.range_root;
+	range->open_node = parser.current_node;
+	range->stop = parser.tree->errors.first ? range->begin : parser.cursor;
+}
+
+static void
+attach_range(RSS_Tree_Node *parent, RSS_Tree_Node *root)
+{
+	RSS_Tree_Node *first = root->first_child;
+	if (first)
+	{
+		RSS_Tree_Node *last = first;
+		for (RSS_Tree_Node *child = first; child; child = child->next_sibling)
+		{
+			child->parent = parent;
+			last = child;
+		}
+
+		// NOTE(ariel) Match the links push_rss_node() makes, where a parent with
+		// only one child has no last child.
+		RSS_Tree_Node *previous = parent->last_child ? parent->last_child : parent->first_child;
+		if (previous)
+		{
+			previous->next_sibling = first;
+			first->prev_sibling = previous;
+			parent->last_child = last;
+		}
+		else
+		{
+			parent->first_child = first;
+			parent->last_child = root->last_child;
+		}
+	}
+
+	if (root->content.str)
+	{
+		parent->content = root->content;
+	}
+}
+
+static RSS_Tree *
+stitch_rss(arena *Arena, string source, RSS_Range_List ranges)
+{
+	RSS_Parser parser = {0};
+	begin_parse_rss(&parser, Arena);
+	parser.source = source;
+
+	for (s32 index = 0; index < ranges.count; index += 1)
+	{
+		RSS_Range *range = &ranges.ranges[index];
+		parser.end = range->begin;
+		parse_tree(&parser);
+
+		// NOTE(ariel) A range parsed on its own matches the serial parse if and
+		// only if the serial parse reaches the beginning of the range inside some
+		// element.
+		b32 valid = parser.cursor == range->begin && parser.current_node &&
+			range->stop > range->begin && !parser.tree->errors.first;
+		if (valid)
+		{
+			attach_range(parser.current_node, range->root);
+			if (range->open_node != range->root)
+			{
+				parser.current_node = range->open_node;
+			}
+			parser.cursor = range->stop;
+			range->stitched = true;
+		}
+	}
+
+	parser.end = 0;
+	RSS_Tree *tree = finish_parse_rss(&parser, source);
+	return tree;
+}
+
+static void
+release_rss_ranges(RSS_Range_List ranges)
+{
+	for (s32 index = 0; index < ranges.count; index += 1)
+	{
+		if (ranges.ranges[index].root)
+		{
+			ReleaseArena(&ranges.ranges[index].Arena);
+		}
+	}
 }
 
 
@@ -477,11 +1228,6 @@ is_stack_empty(Stack *s)
 	return !s->top;
 }
 
-// NOTE(ariel) RSS uses the keyword "item". Atom uses the keyword "entry".
-global string item_string = static_string_literal("item");
-global string entry_string = static_string_literal("entry");
-global string title_string = static_string_literal("title");
-
 static RSS_Tree_Node *
 find_feed_title(arena *Arena, RSS_Tree_Node *root)
 {
@@ -499,7 +1245,7 @@ find_feed_title(arena *Arena, RSS_Tree_Node *root)
 				continue;
 			}
 
-			if (string_match(title_string, node->name))
+			if (node->name_id == RSS_NAME_TITLE)
 			{
 				title_node = node;
 				break;
@@ -515,16 +1261,16 @@ find_feed_title(arena *Arena, RSS_Tree_Node *root)
 }
 
 static RSS_Tree_Node *
-find_item_child_node(RSS_Tree_Node *item, string name)
+find_item_child_node(RSS_Tree_Node *item, RSS_Name_ID name_id)
 {
 	RSS_Tree_Node *child_node = 0;
 
-	if (string_match(item_string, item->name) || string_match(entry_string, item->name))
+	if (is_item_name(item->name_id))
 	{
 		RSS_Tree_Node *node = item->first_child;
 		while (node)
 		{
-			if (string_match(name, node->name))
+			if (name_id == node->name_id)
 			{
 				child_node = node;
 				break;
@@ -541,12 +1287,12 @@ find_item_title(RSS_Tree_Node *item)
 {
 	RSS_Tree_Node *item_title_node = 0;
 
-	if (string_match(item_string, item->name) || string_match(entry_string, item->name))
+	if (is_item_name(item->name_id))
 	{
 		RSS_Tree_Node *node = item->first_child;
 		while (node)
 		{
-			if (string_match(title_string, node->name))
+			if (node->name_id == RSS_NAME_TITLE)
 			{
 				item_title_node = node;
 				break;
@@ -563,12 +1309,12 @@ find_item_link(RSS_Tree_Node *item)
 {
 	RSS_Tree_Node *item_link_node = 0;
 
-	if (string_match(item_string, item->name) || string_match(entry_string, item->name))
+	if (is_item_name(item->name_id))
 	{
 		RSS_Tree_Node *node = item->first_child;
 		while (node)
 		{
-			if (string_match(string_literal("link"), node->name))
+			if (node->name_id == RSS_NAME_LINK)
 			{
 				item_link_node = node;
 				break;
@@ -598,7 +1344,7 @@ find_item_node(arena *Arena, RSS_Tree_Node *root)
 				continue;
 			}
 
-			if (string_match(item_string, node->name) || string_match(entry_string, node->name))
+			if (is_item_name(node->name_id))
 			{
 				item_node = node;
 				break;
@@ -621,45 +1367,95 @@ find_link(RSS_Tree_Node *item)
 	RSS_Tree_Node *link_node = find_item_link(item);
 	if (link_node)
 	{
-		if (link_node->content.len > 0)
+		link = choose_link(link_node->content, link_node->attributes);
+	}
+
+	return link;
+}
+
+static void
+extract_item(RSS_Tree_Node *node, RSS_Handlers *handlers)
+{
+	RSS_Item item = {0};
+	RSS_Tree_Node *item_title = find_item_title(node);
+	if (item_title)
+	{
+		item.title = item_title->content;
+	}
+	item.link = find_link(node);
+
+	// NOTE(ariel) Prefer the date an item was last updated over the date it was
+	// published.
+	RSS_Tree_Node *date = find_item_child_node(node, RSS_NAME_UPDATED);
+	if (!date)
+	{
+		date = find_item_child_node(node, RSS_NAME_PUB_DATE);
+	}
+	if (date)
+	{
+		item.date = date->content;
+	}
+
+	handlers->item(handlers->user_data, &item);
+}
+
+static b32
+is_descendant(RSS_Tree_Node *node, RSS_Tree_Node *ancestor)
+{
+	while (node && node != ancestor)
+	{
+		node = node->parent;
+	}
+	return node != 0;
+}
+
+static void
+extract_rss_from_tree(arena *Arena, RSS_Tree *tree, RSS_Handlers *handlers)
+{
+	RSS_Tree_Node *title = find_feed_title(Arena, tree->root);
+	RSS_Tree_Node *first_item = find_item_node(Arena, tree->root);
+
+	// NOTE(ariel) Walk the tree in document order but skip the children of items,
+	// so that the handlers see calls in the order extract_rss() makes them as it
+	// closes each element.
+	RSS_Tree_Node *node = tree->root;
+	while (node)
+	{
+		if (is_item_name(node->name_id))
 		{
-			link = link_node->content;
+			// NOTE(ariel) The first title of a feed without one of its own lies in an
+			// item, and it closes before the item does.
+			if (title && handlers->feed_title && is_descendant(title, node))
+			{
+				handlers->feed_title(handlers->user_data, title->content);
+			}
+			if (handlers->item && node->parent == first_item->parent)
+			{
+				extract_item(node, handlers);
+			}
 		}
-		else
+		else if (node == title && handlers->feed_title)
 		{
-			b32 type_equals_html = false;
-			b32 rel_equals_alternate = false;
-			RSS_Attribute *href = 0;
-			for (RSS_Attribute *attr = link_node->attributes; attr != 0; attr = attr->next)
-			{
-				if (string_match(attr->name, string_literal("href")))
-				{
-					href = attr;
-				}
-				else if (string_match(attr->name, string_literal("rel")))
-				{
-					rel_equals_alternate = string_match(attr->value, string_literal("alternate"));
-				}
-				else if (string_match(attr->name, string_literal("type")))
-				{
-					type_equals_html = string_match(attr->value, string_literal("text/html"));
-				}
+			handlers->feed_title(handlers->user_data, title->content);
+		}
 
-				if (rel_equals_alternate && type_equals_html && href)
-				{
-					link = href->value;
-					break;
-				}
-			}
+		RSS_Name_ID parent_name_id = node->parent ? node->parent->name_id : RSS_NAME_UNKNOWN;
+		if (handlers->refresh_hint && is_refresh_hint(node->name_id, parent_name_id))
+		{
+			handlers->refresh_hint(handlers->user_data, node->name_id, node->content);
+		}
 
-			if (!link.str && href)
+		if (node->first_child && !is_item_name(node->name_id))
+		{
+			node = node->first_child;
+		}
+		else
+		{
+			while (node && node != tree->root && !node->next_sibling)
 			{
-				// NOTE(ariel) Choose any link if no tag strictly matches the
-				// requirements above.
-				link = href->value;
+				node = node->parent;
 			}
+			node = node && node != tree->root ? node->next_sibling : 0;
 		}
 	}
-
-	return link;
 }
@@ -1,14 +1,62 @@
 #ifndef RSS_H
 #define RSS_H
 
+// NOTE(ariel) The parser classifies every tag and attribute name it reads as
+// one of these names, or RSS_NAME_UNKNOWN, so lookups compare integers rather
+// than strings. Each entry lists the first and last characters of the name to
+// compute its slot in a perfect hash table at compile time. Two names that
+// collide initialize the same slot twice, which compilers warn about with
+// -Wextra.
+#define RSS_NAMES \
+	RSS_NAME(ITEM,                 "item",               'i', 'm') \
+	RSS_NAME(ENTRY,                "entry",              'e', 'y') \
+	RSS_NAME(TITLE,                "title",              't', 'e') \
+	RSS_NAME(LINK,                 "link",               'l', 'k') \
+	RSS_NAME(PUB_DATE,             "pubDate",            'p', 'e') \
+	RSS_NAME(UPDATED,              "updated",            'u', 'd') \
+	RSS_NAME(HREF,                 "href",               'h', 'f') \
+	RSS_NAME(REL,                  "rel",                'r', 'l') \
+	RSS_NAME(TYPE,                 "type",               't', 'e') \
+	RSS_NAME(GUID,                 "guid",               'g', 'd') \
+	RSS_NAME(IS_PERMALINK,         "isPermaLink",        'i', 'k') \
+	RSS_NAME(ENCLOSURE,            "enclosure",          'e', 'e') \
+	RSS_NAME(URL,                  "url",                'u', 'l') \
+	RSS_NAME(LENGTH,               "length",             'l', 'h') \
+	RSS_NAME(MEDIA_CONTENT,        "media:content",      'm', 't') \
+	RSS_NAME(TTL,                  "ttl",                't', 'l') \
+	RSS_NAME(SY_UPDATE_PERIOD,     "sy:updatePeriod",    's', 'd') \
+	RSS_NAME(SY_UPDATE_FREQUENCY,  "sy:updateFrequency", 's', 'y') \
+	RSS_NAME(SKIP_HOURS,           "skipHours",          's', 's') \
+	RSS_NAME(HOUR,                 "hour",               'h', 'r') \
+
+typedef u8 RSS_Name_ID;
+enum
+{
+	RSS_NAME_UNKNOWN,
+#define RSS_NAME(id, text, first, last) RSS_NAME_##id,
+	RSS_NAMES
+#undef RSS_NAME
+	RSS_NAME_COUNT,
+};
+
 typedef struct RSS_Attribute RSS_Attribute;
 struct RSS_Attribute
 {
-	RSS_Attribute *next;
+	RSS_Name_ID name_id;
 	string name;
 	string value;
 };
 
+// NOTE(ariel) The parser only records the raw text between the name of a start
+// tag and its end, e.g. ` href="a" rel="b"`, and parses attributes from it on
+// demand with this iterator.
+typedef struct RSS_Attribute_Iterator RSS_Attribute_Iterator;
+struct RSS_Attribute_Iterator
+{
+	string source;
+	s32 cursor;
+};
+
 typedef struct RSS_Tree_Node RSS_Tree_Node;
 struct RSS_Tree_Node
 {
@@ -17,7 +65,8 @@ struct RSS_Tree_Node
 	RSS_Tree_Node *last_child;
 	RSS_Tree_Node *prev_sibling;
 	RSS_Tree_Node *next_sibling;
-	RSS_Attribute *attributes;
+	string attributes;
+	RSS_Name_ID name_id;
 	string name;
 	string content;
 };
@@ -56,10 +105,126 @@ struct RSS_Tree_List
 	RSS_Tree *last;
 };
 
+typedef struct RSS_Item RSS_Item;
+struct RSS_Item
+{
+	RSS_Item *next;
+	string title;
+	string link;
+	string date;
+};
+
+// NOTE(ariel) The parser calls these as it closes the first title element of
+// the document and each item or entry. Strings refer to the source, and the
+// item passed to the callback only lives until the callback returns. It calls
+// `refresh_hint` with each ttl, sy:updatePeriod, sy:updateFrequency, and hour
+// of skipHours element outside of items.
+typedef struct RSS_Handlers RSS_Handlers;
+struct RSS_Handlers
+{
+	void *user_data;
+	void (*feed_title)(void *user_data, string title);
+	void (*item)(void *user_data, RSS_Item *item);
+	void (*refresh_hint)(void *user_data, RSS_Name_ID name_id, string content);
+};
+
+// NOTE(ariel) extract_rss() fails documents that nest elements any deeper.
+enum { RSS_MAX_ELEMENT_DEPTH = 32 };
+
+typedef struct RSS_Element RSS_Element;
+struct RSS_Element
+{
+	RSS_Name_ID name_id;
+	string name;
+	string content;
+	string attributes;
+};
+
+// NOTE(ariel) A range of a document that begins at a speculative item boundary.
+// A worker parses the range on its own under a stand-in root, and the range
+// only becomes part of the tree if the serial parse of the rest of the document
+// arrives at `begin` exactly, in which case the serial parse resumes at `stop`
+// inside `open_node`. The nodes of the range live in its own arena.
+typedef struct RSS_Range RSS_Range;
+struct RSS_Range
+{
+	arena Arena;
+	string source;
+	s32 begin;
+	s32 end;
+	s32 stop;
+	RSS_Tree_Node *root;
+	RSS_Tree_Node *open_node;
+	b32 stitched;
+};
+
+typedef struct RSS_Range_List RSS_Range_List;
+struct RSS_Range_List
+{
+	RSS_Range *ranges;
+	s32 count;
+};
+
+typedef struct RSS_Parser RSS_Parser;
+struct RSS_Parser
+{
+	arena *Arena;
+	RSS_Tree *tree;
+	RSS_Tree_Node *current_node;
+	string source;
+	s32 cursor;
+
+	// NOTE(ariel) The parser stops at the first token at or past `end` unless
+	// it's zero, and at the end tag of `range_root` rather than pop it when it
+	// parses a range of a document on its own.
+	s32 end;
+	RSS_Tree_Node *range_root;
+
+	// NOTE(ariel) The parser uses the following fields instead of the tree when
+	// it extracts items for handlers.
+	RSS_Handlers *handlers;
+	s32 depth;
+	RSS_Element elements[RSS_MAX_ELEMENT_DEPTH];
+	s32 feed_title_depth;
+	b32 found_feed_title;
+	s32 item_depth;
+	b32 items_ended;
+	b32 in_item;
+	u32 item_fields;
+	RSS_Item item;
+};
+
+static RSS_Name_ID classify_name(string name);
+static string name_of_id(RSS_Name_ID name_id);
+
+// NOTE(ariel) Iterate over the attributes of a node in document order. The
+// iterator stops at the first malformed attribute.
+static RSS_Attribute_Iterator iterate_attributes(string attributes);
+static b32 next_attribute(RSS_Attribute_Iterator *iterator, RSS_Attribute *attribute);
+static string find_attribute(string attributes, RSS_Name_ID name_id);
+
 static RSS_Tree *parse_rss(arena *Arena, string source);
 
+// NOTE(ariel) Extract the feed title and items in a single pass without
+// building a tree. The returned tree only holds errors.
+static RSS_Tree *extract_rss(arena *Arena, string source, RSS_Handlers *handlers);
+
+// NOTE(ariel) Parse a document in parallel: split it into at most
+// `max_range_count` ranges at item boundaries, call parse_rss_range() for each
+// range on any thread, and then stitch the ranges into a tree on one thread.
+// The tree matches the tree parse_rss() returns for the same source. Release
+// the ranges once done with the tree since it refers to their nodes.
+static RSS_Range_List split_rss(arena *Arena, string source, s32 max_range_count);
+static void parse_rss_range(RSS_Range *range);
+static RSS_Tree *stitch_rss(arena *Arena, string source, RSS_Range_List ranges);
+static void release_rss_ranges(RSS_Range_List ranges);
+
+// NOTE(ariel) Call the handlers with the feed title, items, and refresh hints
+// of a tree in the same order extract_rss() calls them for its source.
+static void extract_rss_from_tree(arena *Arena, RSS_Tree *tree, RSS_Handlers *handlers);
+
 static RSS_Tree_Node *find_feed_title(arena *Arena, RSS_Tree_Node *root);
-static RSS_Tree_Node *find_item_child_node(RSS_Tree_Node *item, string name);
+static RSS_Tree_Node *find_item_child_node(RSS_Tree_Node *item, RSS_Name_ID name_id);
 static RSS_Tree_Node *find_item_title(RSS_Tree_Node *item);
 static RSS_Tree_Node *find_item_link(RSS_Tree_Node *item);
 static RSS_Tree_Node *find_item_node(arena *Arena, RSS_Tree_Node *root);
@@ -0,0 +1,321 @@
+static s64
+ParseHintNumber(string Content)
+{
+	// NOTE(ariel) Return -1 for anything but a plain decimal number. Stop
+	// accumulating digits well before the number could overflow.
+	string Digits = string_trim_spaces(Content);
+	s64 Number = Digits.len > 0 ? 0 : -1;
+	for(s32 Index = 0; Index < Digits.len && Number >= 0; Index += 1)
+	{
+		char Character = Digits.str[Index];
+		b32 IsDigit = Character >= '0' && Character <= '9';
+		Number = IsDigit ? MIN(10*Number + (Character - '0'), (s64)MAX_REFRESH_INTERVAL) : -1;
+	}
+	return Number;
+}
+
+static void
+StoreRefreshHint(refresh_hints *Hints, RSS_Name_ID NameID, string Content)
+{
+	switch(NameID)
+	{
+		case RSS_NAME_TTL:
+		{
+			s64 Minutes = ParseHintNumber(Content);
+			if(Minutes >= 0)
+			{
+				Hints->TTL = 60*Minutes;
+			}
+		} break;
+		case RSS_NAME_SY_UPDATE_PERIOD:
+		{
+			local_persist string Periods[] =
+			{
+				static_string_literal("hourly"),
+				static_string_literal("daily"),
+				static_string_literal("weekly"),
+				static_string_literal("monthly"),
+				static_string_literal("yearly"),
+			};
+			local_persist s64 PeriodLengths[] = { 60*60, 24*60*60, 7*24*60*60, 30*24*60*60, 365*24*60*60 };
+
+			string Period = string_trim_spaces(Content);
+			for(s32 Index = 0; Index < (s32)ARRAY_COUNT(Periods); Index += 1)
+			{
+				if(string_match(Period, Periods[Index]))
+				{
+					Hints->UpdatePeriod = PeriodLengths[Index];
+				}
+			}
+		} break;
+		case RSS_NAME_SY_UPDATE_FREQUENCY:
+		{
+			s64 Frequency = ParseHintNumber(Content);
+			if(Frequency > 0)
+			{
+				Hints->UpdateFrequency = Frequency;
+			}
+		} break;
+		case RSS_NAME_HOUR:
+		{
+			// NOTE(ariel) Some publishers write midnight as 24 rather than 0.
+			s64 Hour = ParseHintNumber(Content);
+			if(Hour >= 0 && Hour <= 24)
+			{
+				Hints->SkipHours |= 1u << (Hour % 24);
+			}
+		} break;
+	}
+}
+
+static s64
+ComputeRefreshInterval(refresh_hints Hints, s64 *ItemTimestamps, s32 ItemCount, s64 Now)
+{
+	s32 DatedItemCount = 0;
+	s64 Newest = 0;
+	s64 Oldest = INT64_MAX;
+	for(s32 Index = 0; Index < ItemCount; Index += 1)
+	{
+		if(ItemTimestamps[Index] > 0)
+		{
+			// NOTE(ariel) Treat items dated in the future as though they just arrived.
+			s64 ItemTime = MIN(ItemTimestamps[Index], Now);
+			Newest = MAX(Newest, ItemTime);
+			Oldest = MIN(Oldest, ItemTime);
+			DatedItemCount += 1;
+		}
+	}
+
+	s64 Interval = DEFAULT_REFRESH_INTERVAL;
+	if(DatedItemCount >= 2 && Newest > Oldest)
+	{
+		s64 MeanGap = (Newest - Oldest) / (DatedItemCount - 1);
+		Interval = MeanGap / 2;
+	}
+	if(DatedItemCount >= 1)
+	{
+		// NOTE(ariel) A feed that has gone quiet for longer than it usually does
+		// likely stays quiet for a while longer.
+		Interval = MAX(Interval, (Now - Newest) / 4);
+	}
+	Interval = CLAMP(Interval, (s64)MIN_REFRESH_INTERVAL, (s64)MAX_OBSERVED_REFRESH_INTERVAL);
+
+	Interval = MAX(Interval, Hints.TTL);
+	if(Hints.UpdatePeriod)
+	{
+		Interval = MAX(Interval, Hints.UpdatePeriod / MAX(Hints.UpdateFrequency, 1));
+	}
+	Interval = MIN(Interval, (s64)MAX_REFRESH_INTERVAL);
+
+	return Interval;
+}
+
+static s64
+SkipToAllowedHour(s64 Time, u32 SkipHours)
+{
+	enum { SECONDS_PER_HOUR = 60*60 };
+	for(s32 Step = 0; Step < 24 && (SkipHours & (1u << ((Time / SECONDS_PER_HOUR) % 24))); Step += 1)
+	{
+		Time = (Time / SECONDS_PER_HOUR + 1) * SECONDS_PER_HOUR;
+	}
+	return Time;
+}
+
+static s64
+ComputeRetryDelay(s32 FailureCount, u64 Seed)
+{
+	s64 Delay = 0;
+	if(FailureCount > 0)
+	{
+		s32 Doublings = MIN(FailureCount - 1, 20);
+		s64 Backoff = MIN((s64)MIN_RETRY_DELAY << Doublings, (s64)MAX_RETRY_DELAY);
+
+		// NOTE(ariel) Mix the seed with SplitMix64's finalizer so that nearby
+		// seeds give unrelated jitter.
+		u64 Random = Seed + 0x9e3779b97f4a7c15;
+		Random = (Random ^ (Random >> 30)) * 0xbf58476d1ce4e5b9;
+		Random = (Random ^ (Random >> 27)) * 0x94d049bb133111eb;
+		Random = Random ^ (Random >> 31);
+
+		Delay = Backoff/2 + (s64)(Random % (u64)(Backoff/2 + 1));
+	}
+	return Delay;
+}
+
+static b32
+CircuitIsOpen(s32 FailureCount, s64 RetryTime, s64 Now)
+{
+	b32 Result = FailureCount >= CIRCUIT_BREAKER_FAILURE_COUNT && Now < RetryTime;
+	return Result;
+}
+
+static void
+ScheduleFeed(feed_schedule *Schedule, string Link, s64 DueTime)
+{
+	scheduled_feed NewFeed = { .DueTime = DueTime, .Link = { .str = malloc(Link.len), .len = Link.len } };
+	memcpy(NewFeed.Link.str, Link.str, Link.len);
+
+	pthread_mutex_lock(&Schedule->Mutex);
+	{
+		if(Schedule->FeedCount == Schedule->MaxFeedCount)
+		{
+			Schedule->MaxFeedCount = MAX(64, 2*Schedule->MaxFeedCount);
+			Schedule->Feeds = realloc(Schedule->Feeds, Schedule->MaxFeedCount*sizeof(scheduled_feed));
+			AssertAlways(Schedule->Feeds);
+		}
+
+		s32 Index = Schedule->FeedCount;
+		Schedule->FeedCount += 1;
+		while(Index > 0)
+		{
+			s32 ParentIndex = (Index - 1) / 2;
+			if(Schedule->Feeds[ParentIndex].DueTime <= NewFeed.DueTime)
+			{
+				break;
+			}
+			Schedule->Feeds[Index] = Schedule->Feeds[ParentIndex];
+			Index = ParentIndex;
+		}
+		Schedule->Feeds[Index] = NewFeed;
+	}
+	pthread_mutex_unlock(&Schedule->Mutex);
+}
+
+static b32
+PopDueFeed(feed_schedule *Schedule, s64 Now, scheduled_feed *Feed)
+{
+	b32 FeedIsDue = false;
+
+	pthread_mutex_lock(&Schedule->Mutex);
+	if(Schedule->FeedCount > 0 && Schedule->Feeds[0].DueTime <= Now)
+	{
+		FeedIsDue = true;
+		*Feed = Schedule->Feeds[0];
+
+		Schedule->FeedCount -= 1;
+		scheduled_feed LastFeed = Schedule->Feeds[Schedule->FeedCount];
+		s32 Index = 0;
+		for(;;)
+		{
+			s32 ChildIndex = 2*Index + 1;
+			if(ChildIndex >= Schedule->FeedCount)
+			{
+				break;
+			}
+			if(ChildIndex + 1 < Schedule->FeedCount &&
+				Schedule->Feeds[ChildIndex + 1].DueTime < Schedule->Feeds[ChildIndex].DueTime)
+			{
+				ChildIndex += 1;
+			}
+			if(LastFeed.DueTime <= Schedule->Feeds[ChildIndex].DueTime)
+			{
+				break;
+			}
+			Schedule->Feeds[Index] = Schedule->Feeds[ChildIndex];
+			Index = ChildIndex;
+		}
+		Schedule->Feeds[Index] = LastFeed;
+	}
+	pthread_mutex_unlock(&Schedule->Mutex);
+
+	return FeedIsDue;
+}
+
+// NOTE(ariel) Slots hold an ID with a bit set above it so that zero marks an
+// empty slot even for ID 0. IDs are already hashes, so their low bits pick
+// slots directly, and collisions probe linearly.
+#define IN_FLIGHT_SLOT(FeedID) ((u64)(FeedID) | (1ull << 32))
+
+static void
+InsertInFlightSlot(in_flight_feeds *Feeds, u64 Slot)
+{
+	u32 Mask = Feeds->SlotCount - 1;
+	u32 Index = (u32)Slot & Mask;
+	while(Feeds->Slots[Index])
+	{
+		Index = (Index + 1) & Mask;
+	}
+	Feeds->Slots[Index] = Slot;
+}
+
+static b32
+BeginRefresh(in_flight_feeds *Feeds, u32 FeedID)
+{
+	b32 Began = true;
+	u64 NewSlot = IN_FLIGHT_SLOT(FeedID);
+
+	pthread_mutex_lock(&Feeds->Mutex);
+	{
+		// NOTE(ariel) Keep the table at most half full so that probes stay short.
+		if(2*(Feeds->FeedCount + 1) > Feeds->SlotCount)
+		{
+			u64 *OldSlots = Feeds->Slots;
+			s32 OldSlotCount = Feeds->SlotCount;
+			Feeds->SlotCount = MAX(64, 2*Feeds->SlotCount);
+			Feeds->Slots = calloc(Feeds->SlotCount, sizeof(u64));
+			AssertAlways(Feeds->Slots);
+			for(s32 Index = 0; Index < OldSlotCount; Index += 1)
+			{
+				if(OldSlots[Index])
+				{
+					InsertInFlightSlot(Feeds, OldSlots[Index]);
+				}
+			}
+			free(OldSlots);
+		}
+
+		u32 Mask = Feeds->SlotCount - 1;
+		for(u32 Index = FeedID & Mask; Feeds->Slots[Index]; Index = (Index + 1) & Mask)
+		{
+			if(Feeds->Slots[Index] == NewSlot)
+			{
+				Began = false;
+				break;
+			}
+		}
+		if(Began)
+		{
+			InsertInFlightSlot(Feeds, NewSlot);
+			Feeds->FeedCount += 1;
+		}
+	}
+	pthread_mutex_unlock(&Feeds->Mutex);
+
+	return Began;
+}
+
+static void
+EndRefresh(in_flight_feeds *Feeds, u32 FeedID)
+{
+	u64 OldSlot = IN_FLIGHT_SLOT(FeedID);
+
+	pthread_mutex_lock(&Feeds->Mutex);
+	{
+		u32 Mask = Feeds->SlotCount - 1;
+		u32 Index = FeedID & Mask;
+		while(Feeds->Slots[Index] != OldSlot)
+		{
+			Assert(Feeds->Slots[Index]);
+			Index = (Index + 1) & Mask;
+		}
+
+		// NOTE(ariel) Shift later entries of the same run back into the hole so
+		// that lookups never stop short of them, rather than leave tombstones.
+		u32 Hole = Index;
+		for(Index = (Index + 1) & Mask; Feeds->Slots[Index]; Index = (Index + 1) & Mask)
+		{
+			u32 Home = (u32)Feeds->Slots[Index] & Mask;
+			b32 HomeLiesAfterHole = ((Index - Home) & Mask) < ((Index - Hole) & Mask);
+			if(!HomeLiesAfterHole)
+			{
+				Feeds->Slots[Hole] = Feeds->Slots[Index];
+				Hole = Index;
+			}
+		}
+		Feeds->Slots[Hole] = 0;
+		Feeds->FeedCount -= 1;
+	}
+	pthread_mutex_unlock(&Feeds->Mutex);
+}
+
+#undef IN_FLIGHT_SLOT
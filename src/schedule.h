@@ -0,0 +1,94 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+// NOTE(ariel) Times and intervals count seconds since the Unix epoch.
+enum
+{
+	MIN_REFRESH_INTERVAL          = 15*60,
+	DEFAULT_REFRESH_INTERVAL      = 60*60,
+	MAX_OBSERVED_REFRESH_INTERVAL = 24*60*60,
+	MAX_REFRESH_INTERVAL          = 7*24*60*60,
+
+	MIN_RETRY_DELAY               = 60,
+	MAX_RETRY_DELAY               = 24*60*60,
+	CIRCUIT_BREAKER_FAILURE_COUNT = 5,
+};
+
+// NOTE(ariel) Publishers may state how often to poll a feed with <ttl> (in
+// minutes), or <sy:updatePeriod> and <sy:updateFrequency> (the number of
+// updates per period), and which hours (GMT) to skip with <skipHours>.
+typedef struct refresh_hints refresh_hints;
+struct refresh_hints
+{
+	s64 TTL;
+	s64 UpdatePeriod;
+	s64 UpdateFrequency;
+	u32 SkipHours;
+};
+
+static void StoreRefreshHint(refresh_hints *Hints, RSS_Name_ID NameID, string Content);
+
+// NOTE(ariel) Poll a feed about twice as often as items arrive on average,
+// back off as it goes quiet, and never more often than its publisher asks.
+// `ItemTimestamps` may be empty and holds zeros for items without a date.
+static s64 ComputeRefreshInterval(refresh_hints Hints, s64 *ItemTimestamps, s32 ItemCount, s64 Now);
+
+// NOTE(ariel) Move the time forward to the start of the next hour not in the
+// mask of hours to skip.
+static s64 SkipToAllowedHour(s64 Time, u32 SkipHours);
+
+// NOTE(ariel) Wait twice as long after each consecutive failure, give or take
+// up to half the delay at random so that feeds that failed together don't retry
+// together. `Seed` picks the jitter.
+static s64 ComputeRetryDelay(s32 FailureCount, u64 Seed);
+
+// NOTE(ariel) Stop refreshing a feed that keeps failing until its retry time
+// arrives, even if the user reloads all feeds.
+static b32 CircuitIsOpen(s32 FailureCount, s64 RetryTime, s64 Now);
+
+typedef struct scheduled_feed scheduled_feed;
+struct scheduled_feed
+{
+	s64 DueTime;
+	string Link;
+};
+
+// NOTE(ariel) A min-heap of feeds by the time they next fall due. Any thread
+// may schedule a feed. The heap owns copies of links. It doesn't look for
+// earlier entries of the same feed, so the caller must recognize and skip
+// stale ones as they fall due.
+typedef struct feed_schedule feed_schedule;
+struct feed_schedule
+{
+	pthread_mutex_t Mutex;
+	s32 FeedCount;
+	s32 MaxFeedCount;
+	scheduled_feed *Feeds;
+};
+
+static void ScheduleFeed(feed_schedule *Schedule, string Link, s64 DueTime);
+
+// NOTE(ariel) Pop the feed that falls due first if it falls due by `Now`. The
+// caller owns the link it returns and must free() it.
+static b32 PopDueFeed(feed_schedule *Schedule, s64 Now, scheduled_feed *Feed);
+
+// NOTE(ariel) The set of feeds queued or in the middle of a refresh, keyed by
+// their IDs in the database. Any thread may add or remove a feed. A request to
+// refresh a feed already in the set merges into the refresh in flight, so that
+// two refreshes never fetch the same feed at once or race on its rows.
+typedef struct in_flight_feeds in_flight_feeds;
+struct in_flight_feeds
+{
+	pthread_mutex_t Mutex;
+	s32 FeedCount;
+	s32 SlotCount;
+	u64 *Slots;
+};
+
+// NOTE(ariel) BeginRefresh() adds the feed and returns true only if the feed
+// wasn't in flight already. The caller must call EndRefresh() once the refresh
+// it began ends, however it ends.
+static b32 BeginRefresh(in_flight_feeds *Feeds, u32 FeedID);
+static void EndRefresh(in_flight_feeds *Feeds, u32 FeedID);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+// NOTE(ariel) A watcher reports files that change in the directories it
+// watches, i.e. files closed after writing and files moved into them. Hidden
+// files and directories never count. Polling never blocks, so the main thread
+// polls once per frame.
+typedef struct watched_directory watched_directory;
+struct watched_directory
+{
+	s32 Handle;
+	string Path;
+	b32 WatchEveryFile;
+};
+
+typedef struct changed_file changed_file;
+struct changed_file
+{
+	string Path;
+
+	// NOTE(ariel) Whether the file lies in a directory watched for every file in
+	// it, rather than only for particular files the caller knows of.
+	b32 InWatchedDirectory;
+};
+
+typedef struct file_watcher file_watcher;
+struct file_watcher
+{
+	s32 Handle;
+	s32 DirectoryCount;
+	s32 MaxDirectoryCount;
+	watched_directory *Directories;
+
+	// NOTE(ariel) The watcher reads events in batches and hands them out one at
+	// a time.
+	s32 EventByteCount;
+	s32 EventCursor;
+	u64 Events[512];
+};
+
+// NOTE(ariel) StartFileWatcher() returns false if the platform can't watch
+// files, in which case the other procedures do nothing. Watching a directory
+// twice watches it once, for every file if either asked for every file.
+static b32 StartFileWatcher(file_watcher *Watcher);
+static void StopFileWatcher(file_watcher *Watcher);
+static void WatchDirectory(file_watcher *Watcher, string Path, b32 WatchEveryFile);
+static b32 PollChangedFile(file_watcher *Watcher, arena *Arena, changed_file *File);
+
+#endif
@@ -0,0 +1,120 @@
+#include <limits.h>
+#include <sys/inotify.h>
+
+static b32
+StartFileWatcher(file_watcher *Watcher)
+{
+	Watcher->Handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	b32 Success = Watcher->Handle >= 0;
+	return Success;
+}
+
+static void
+StopFileWatcher(file_watcher *Watcher)
+{
+	if(Watcher->Handle >= 0)
+	{
+		close(Watcher->Handle);
+	}
+	for(s32 Index = 0; Index < Watcher->DirectoryCount; Index += 1)
+	{
+		free(Watcher->Directories[Index].Path.str);
+	}
+	free(Watcher->Directories);
+	ZeroStruct(Watcher);
+	Watcher->Handle = -1;
+}
+
+static void
+WatchDirectory(file_watcher *Watcher, string Path, b32 WatchEveryFile)
+{
+	if(Watcher->Handle < 0)
+	{
+		return;
+	}
+
+	char TerminatedPath[PATH_MAX] = {0};
+	if(Path.len >= (s32)sizeof(TerminatedPath))
+	{
+		return;
+	}
+	memcpy(TerminatedPath, Path.str, Path.len);
+
+	// NOTE(ariel) Writers that replace a file by renaming a new one over it
+	// trigger IN_MOVED_TO rather than IN_CLOSE_WRITE. Watching the directory
+	// rather than the file itself also survives such replacements.
+	u32 Events = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+	s32 Handle = inotify_add_watch(Watcher->Handle, TerminatedPath, Events);
+	if(Handle < 0)
+	{
+		return;
+	}
+
+	// NOTE(ariel) The system returns the same handle for the same directory.
+	for(s32 Index = 0; Index < Watcher->DirectoryCount; Index += 1)
+	{
+		watched_directory *Directory = &Watcher->Directories[Index];
+		if(Directory->Handle == Handle)
+		{
+			Directory->WatchEveryFile |= WatchEveryFile;
+			return;
+		}
+	}
+
+	if(Watcher->DirectoryCount == Watcher->MaxDirectoryCount)
+	{
+		Watcher->MaxDirectoryCount = MAX(16, 2*Watcher->MaxDirectoryCount);
+		Watcher->Directories = realloc(Watcher->Directories, Watcher->MaxDirectoryCount*sizeof(watched_directory));
+		AssertAlways(Watcher->Directories);
+	}
+	watched_directory *Directory = &Watcher->Directories[Watcher->DirectoryCount];
+	Watcher->DirectoryCount += 1;
+	Directory->Handle = Handle;
+	Directory->Path.str = malloc(Path.len);
+	Directory->Path.len = Path.len;
+	memcpy(Directory->Path.str, Path.str, Path.len);
+	Directory->WatchEveryFile = WatchEveryFile;
+}
+
+static b32
+PollChangedFile(file_watcher *Watcher, arena *Arena, changed_file *File)
+{
+	if(Watcher->Handle < 0)
+	{
+		return false;
+	}
+
+	for(;;)
+	{
+		if(Watcher->EventCursor >= Watcher->EventByteCount)
+		{
+			ssize_t ByteCount = read(Watcher->Handle, Watcher->Events, sizeof(Watcher->Events));
+			Watcher->EventCursor = 0;
+			Watcher->EventByteCount = ByteCount > 0 ? (s32)ByteCount : 0;
+			if(!Watcher->EventByteCount)
+			{
+				return false;
+			}
+		}
+
+		struct inotify_event *Event = (struct inotify_event *)((u8 *)Watcher->Events + Watcher->EventCursor);
+		Watcher->EventCursor += (s32)sizeof(struct inotify_event) + (s32)Event->len;
+
+		if(!Event->len || Event->name[0] == '.' || (Event->mask & IN_ISDIR))
+		{
+			continue;
+		}
+		for(s32 Index = 0; Index < Watcher->DirectoryCount; Index += 1)
+		{
+			watched_directory *Directory = &Watcher->Directories[Index];
+			if(Directory->Handle == Event->wd)
+			{
+				string Name = { .str = Event->name, .len = (s32)strlen(Event->name) };
+				string Strings[] = { Directory->Path, string_literal("/"), Name };
+				File->Path = concat_strings(Arena, ARRAY_COUNT(Strings), Strings);
+				File->InWatchedDirectory = Directory->WatchEveryFile;
+				return true;
+			}
+		}
+	}
+}
@@ -0,0 +1,14 @@
+#!/usr/bin/env sh
+
+set -eu
+
+PORT="${PORT:-8937}"
+
+${CC:-clang} -g3 -Isrc/ tests/test_fetch.c -pthread `curl-config --cflags --libs` -o tests/test_fetch
+
+python3 tests/fixture_server.py "$PORT" &
+SERVER=$!
+trap 'kill $SERVER' EXIT
+while ! curl -s -o /dev/null "http://127.0.0.1:$PORT/"; do sleep 0.1; done
+
+./tests/test_fetch "http://127.0.0.1:$PORT"
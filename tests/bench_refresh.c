@@ -0,0 +1,358 @@
+#include <dirent.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+#include <sqlite3.h>
+
+#include "base.h"
+#include "memory.h"
+#include "arena.h"
+#include "date_time.h"
+#include "str.h"
+#include "encoding.h"
+#include "rss.h"
+#include "fetch.h"
+#include "db.h"
+#include "schedule.h"
+
+#if defined(__linux__)
+#include "memory_linux.c"
+#elif defined(_WIN64)
+#include "memory_windows.c"
+#else
+#error `memory.h` is not implemented on this platform.
+#endif
+#include "arena.c"
+#include "date_time.c"
+#include "str.c"
+#include "encoding.c"
+#include "rss.c"
+#include "fetch.c"
+#include "db.c"
+#include "schedule.c"
+
+// NOTE(ariel) This benchmark refreshes feeds end to end -- fetch, parse, and
+// store in the database -- the way the program does, but against recordings
+// that tests/replay_server.py serves rather than the network, so runs compare
+// under the same latency and bandwidth every time. Run it through
+// bench_refresh.sh.
+
+enum
+{
+	MAX_TRANSFER_COUNT     = 64,
+	MAX_TRANSFERS_PER_HOST = 6,
+	MAX_RECORDING_COUNT    = 4096,
+	DEFAULT_ROUND_COUNT    = 4,
+	SCHEDULED_FEED_COUNT   = 100000,
+};
+
+typedef struct completion_queue completion_queue;
+struct completion_queue
+{
+	pthread_mutex_t Mutex;
+	pthread_cond_t Finished;
+	s32 TransferCount;
+	fetch_transfer *Transfers[MAX_TRANSFER_COUNT];
+};
+static completion_queue CompletionQueue =
+{
+	.Mutex = PTHREAD_MUTEX_INITIALIZER,
+	.Finished = PTHREAD_COND_INITIALIZER,
+};
+
+typedef struct extracted_feed extracted_feed;
+struct extracted_feed
+{
+	arena *Arena;
+	b32 HasTitle;
+	string Title;
+	s32 ItemCount;
+	RSS_Item *FirstItem;
+	refresh_hints Hints;
+};
+
+typedef struct refresh_totals refresh_totals;
+struct refresh_totals
+{
+	s32 FeedCount;
+	s32 FailedCount;
+	s32 ItemCount;
+	s64 ByteCount;
+};
+
+static f64
+Now(void)
+{
+	struct timespec Time = {0};
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	f64 Seconds = (f64)Time.tv_sec + (f64)Time.tv_nsec*1e-9;
+	return Seconds;
+}
+
+static void
+QueueCompletion(fetch_transfer *Transfer)
+{
+	// NOTE(ariel) The transfer count never exceeds the number of transfers the
+	// engine owns since each one waits here until the main thread releases it.
+	pthread_mutex_lock(&CompletionQueue.Mutex);
+	{
+		CompletionQueue.Transfers[CompletionQueue.TransferCount++] = Transfer;
+	}
+	pthread_mutex_unlock(&CompletionQueue.Mutex);
+	pthread_cond_signal(&CompletionQueue.Finished);
+}
+
+static fetch_transfer *
+WaitForCompletion(void)
+{
+	fetch_transfer *Transfer = 0;
+	pthread_mutex_lock(&CompletionQueue.Mutex);
+	{
+		while(!CompletionQueue.TransferCount)
+		{
+			pthread_cond_wait(&CompletionQueue.Finished, &CompletionQueue.Mutex);
+		}
+		Transfer = CompletionQueue.Transfers[--CompletionQueue.TransferCount];
+	}
+	pthread_mutex_unlock(&CompletionQueue.Mutex);
+	return Transfer;
+}
+
+static void
+StoreFeedTitle(void *UserData, string Title)
+{
+	extracted_feed *Feed = UserData;
+	Feed->HasTitle = true;
+	Feed->Title = Title;
+}
+
+static void
+StoreFeedItem(void *UserData, RSS_Item *Item)
+{
+	extracted_feed *Feed = UserData;
+	RSS_Item *NewItem = PushStructToArena(Feed->Arena, RSS_Item);
+	*NewItem = *Item;
+	NewItem->next = Feed->FirstItem;
+	Feed->FirstItem = NewItem;
+	Feed->ItemCount += 1;
+}
+
+static void
+StoreFeedRefreshHint(void *UserData, RSS_Name_ID NameID, string Content)
+{
+	extracted_feed *Feed = UserData;
+	StoreRefreshHint(&Feed->Hints, NameID, Content);
+}
+
+static void
+RefreshFeed(sqlite3 *db, feed_schedule *Schedule, arena *Arena, fetch_transfer *Transfer, refresh_totals *Totals)
+{
+	// NOTE(ariel) Store the feed the same way the program does in ProcessFeed()
+	// and RescheduleFeed().
+	string Link = *(string *)Transfer->UserData;
+	curl_response *Response = &Transfer->Response;
+	Totals->ByteCount += Response->CompressedByteCount;
+	if(Transfer->Result != CURLE_OK || Transfer->HTTPResponseCode != 200)
+	{
+		Totals->FailedCount += 1;
+		return;
+	}
+
+	extracted_feed Extracted = { .Arena = Arena };
+	RSS_Handlers Handlers =
+	{
+		.user_data = &Extracted,
+		.feed_title = StoreFeedTitle,
+		.item = StoreFeedItem,
+		.refresh_hint = StoreFeedRefreshHint,
+	};
+	RSS_Tree *Feed = extract_rss(Arena, Response->Data, &Handlers);
+	if(Feed->errors.first || !Extracted.HasTitle)
+	{
+		Totals->FailedCount += 1;
+		return;
+	}
+
+	db_add_or_update_feed(db, Link, Extracted.Title);
+	s64 *ItemTimestamps = PushArrayToArena(Arena, s64, Extracted.ItemCount);
+	s32 ItemIndex = 0;
+	for(RSS_Item *Item = Extracted.FirstItem; Item; Item = Item->next, ItemIndex += 1)
+	{
+		db_add_item(db, Link, Item);
+		Timestamp ItemTime = parse_date_time(Item->date);
+		ItemTimestamps[ItemIndex] = ItemTime.error.str ? 0 : (s64)ItemTime.unix_format;
+	}
+	db_set_feed_validators(db, Link, Response->ETag, Response->LastModified);
+
+	s64 Interval = ComputeRefreshInterval(Extracted.Hints, ItemTimestamps, Extracted.ItemCount, time(0));
+	s64 NextRefresh = SkipToAllowedHour(time(0) + Interval, Extracted.Hints.SkipHours);
+	db_set_feed_schedule(db, Link, Interval, Extracted.Hints.SkipHours, NextRefresh);
+	ScheduleFeed(Schedule, Link, NextRefresh);
+
+	Totals->FeedCount += 1;
+	Totals->ItemCount += Extracted.ItemCount;
+}
+
+static void
+Record(char *Directory, s32 URLCount, char **URLs)
+{
+	fetch_engine Engine = { .RecordDirectory = Directory };
+	arena Arena = {0};
+	InitializeArena(&Arena);
+	StartFetchEngine(&Engine, &Arena, MAX_TRANSFER_COUNT, MAX_TRANSFERS_PER_HOST, URLCount, QueueCompletion);
+
+	string *Links = PushArrayToArena(&Arena, string, URLCount);
+	for(s32 Index = 0; Index < URLCount; Index += 1)
+	{
+		Links[Index] = (string){ .str = URLs[Index], .len = (s32)strlen(URLs[Index]) };
+		QueueFetch(&Engine, Links[Index], (fetch_validators){0}, FETCH_PRIORITY_BACKGROUND, &Links[Index]);
+	}
+
+	s32 FailedCount = 0;
+	for(s32 Index = 0; Index < URLCount; Index += 1)
+	{
+		fetch_transfer *Transfer = WaitForCompletion();
+		string Link = *(string *)Transfer->UserData;
+		if(Transfer->Result != CURLE_OK)
+		{
+			fprintf(stderr, "failed to record %.*s: %s\n", Link.len, Link.str, curl_easy_strerror(Transfer->Result));
+			FailedCount += 1;
+		}
+		else
+		{
+			printf("recorded %.*s (%ld) to %s\n", Link.len, Link.str, Transfer->HTTPResponseCode, Transfer->RecordingPath);
+		}
+		ReleaseTransfer(&Engine, Transfer);
+	}
+
+	StopFetchEngine(&Engine);
+	ReleaseArena(&Arena);
+	exit(FailedCount ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static void
+Replay(char *Address, char *Directory, s32 RoundCount)
+{
+	arena Arena = {0};
+	InitializeArena(&Arena);
+
+	// NOTE(ariel) Request each recording by name directly rather than through
+	// ReplayAddress, since names don't reveal the URLs they were recorded from.
+	s32 LinkCount = 0;
+	string *Links = PushArrayToArena(&Arena, string, MAX_RECORDING_COUNT);
+	DIR *RecordingDirectory = opendir(Directory);
+	AssertAlways(RecordingDirectory);
+	for(struct dirent *Entry = readdir(RecordingDirectory); Entry; Entry = readdir(RecordingDirectory))
+	{
+		if(Entry->d_name[0] != '.' && LinkCount < MAX_RECORDING_COUNT)
+		{
+			char URL[1024];
+			s32 Length = snprintf(URL, sizeof(URL), "%s/%s", Address, Entry->d_name);
+			Links[LinkCount++] = string_duplicate(&Arena, (string){ .str = URL, .len = Length });
+		}
+	}
+	closedir(RecordingDirectory);
+	AssertAlways(LinkCount > 0);
+
+	sqlite3 *db = 0;
+	remove(CONFIG_DIRECTORY_PATH "feeds.db");
+	db_init(&db);
+	for(s32 Index = 0; Index < LinkCount; Index += 1)
+	{
+		db_add_feed(db, Links[Index], Links[Index]);
+	}
+
+	feed_schedule Schedule = { .Mutex = PTHREAD_MUTEX_INITIALIZER };
+	fetch_engine Engine = {0};
+	StartFetchEngine(&Engine, &Arena, MAX_TRANSFER_COUNT, MAX_TRANSFERS_PER_HOST, LinkCount, QueueCompletion);
+
+	arena FeedArena = {0};
+	InitializeArena(&FeedArena);
+	arena_checkpoint FeedStart = SetArenaCheckpoint(&FeedArena);
+
+	printf("%-8s %10s %10s %10s %10s %8s\n", "round", "seconds", "feeds/s", "items/s", "MB/s", "failed");
+	f64 Fastest = 1e30;
+	refresh_totals FastestTotals = {0};
+	for(s32 Round = 0; Round < RoundCount; Round += 1)
+	{
+		refresh_totals Totals = {0};
+		f64 Start = Now();
+		for(s32 Index = 0; Index < LinkCount; Index += 1)
+		{
+			QueueFetch(&Engine, Links[Index], (fetch_validators){0}, FETCH_PRIORITY_BACKGROUND, &Links[Index]);
+		}
+		for(s32 Index = 0; Index < LinkCount; Index += 1)
+		{
+			fetch_transfer *Transfer = WaitForCompletion();
+			RefreshFeed(db, &Schedule, &FeedArena, Transfer, &Totals);
+			ReleaseTransfer(&Engine, Transfer);
+			RestoreArenaFromCheckpoint(FeedStart);
+		}
+		f64 Elapsed = Now() - Start;
+
+		printf("%-8d %10.3f %10.1f %10.1f %10.2f %8d\n", Round, Elapsed,
+			Totals.FeedCount / Elapsed, Totals.ItemCount / Elapsed, (f64)Totals.ByteCount / Elapsed / 1e6, Totals.FailedCount);
+		if(Elapsed < Fastest)
+		{
+			Fastest = Elapsed;
+			FastestTotals = Totals;
+		}
+	}
+	printf("fastest round refreshed %d feeds with %d items in %.3f seconds\n",
+		FastestTotals.FeedCount, FastestTotals.ItemCount, Fastest);
+
+	// NOTE(ariel) Every refresh above scheduled its feed again. Drain those
+	// entries along with a large synthetic schedule to time the heap.
+	f64 ScheduleStart = Now();
+	for(s32 Index = 0; Index < SCHEDULED_FEED_COUNT; Index += 1)
+	{
+		u64 Hash = (u64)(Index + 1) * 0x9e3779b97f4a7c15ull;
+		ScheduleFeed(&Schedule, Links[Index % LinkCount], (s64)(Hash >> 40));
+	}
+	s32 PoppedCount = 0;
+	scheduled_feed Scheduled = {0};
+	while(PopDueFeed(&Schedule, INT64_MAX, &Scheduled))
+	{
+		free(Scheduled.Link.str);
+		PoppedCount += 1;
+	}
+	f64 ScheduleElapsed = Now() - ScheduleStart;
+	printf("scheduled and popped %d feeds in %.3f seconds (%.0f ns per feed)\n",
+		PoppedCount, ScheduleElapsed, ScheduleElapsed*1e9 / MAX(PoppedCount, 1));
+	free(Schedule.Feeds);
+
+	StopFetchEngine(&Engine);
+	db_free(db);
+	remove(CONFIG_DIRECTORY_PATH "feeds.db");
+	ReleaseArena(&FeedArena);
+	ReleaseArena(&Arena);
+}
+
+int
+main(int ArgumentCount, char **Arguments)
+{
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+
+	if(ArgumentCount >= 4 && strcmp(Arguments[1], "--record") == 0)
+	{
+		Record(Arguments[2], ArgumentCount - 3, Arguments + 3);
+	}
+	else if(ArgumentCount == 3 || ArgumentCount == 4)
+	{
+		s32 RoundCount = ArgumentCount == 4 ? atoi(Arguments[3]) : DEFAULT_ROUND_COUNT;
+		Replay(Arguments[1], Arguments[2], MAX(RoundCount, 1));
+	}
+	else
+	{
+		fprintf(stderr, "usage: %s --record <directory> <url>...\n", Arguments[0]);
+		fprintf(stderr, "       %s <replay address> <directory> [rounds]\n", Arguments[0]);
+		return EXIT_FAILURE;
+	}
+
+	curl_global_cleanup();
+	return 0;
+}
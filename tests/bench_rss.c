@@ -0,0 +1,542 @@
+#include <dirent.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "base.h"
+#include "memory.h"
+#include "arena.h"
+#include "str.h"
+#include "date_time.h"
+#include "rss.h"
+
+#if defined(__linux__)
+#include "memory_linux.c"
+#elif defined(_WIN64)
+#include "memory_windows.c"
+#else
+#error `memory.h` is not implemented on this platform.
+#endif
+#include "arena.c"
+#include "str.c"
+#include "date_time.c"
+#include "rss.c"
+
+// NOTE(ariel) A run fails if any result regresses past its baseline by more
+// than this fraction. Timings come from the machine that wrote the baseline, so
+// rewrite the baseline with --update after changing machines.
+#define DEFAULT_TOLERANCE 0.25
+#define BASELINE_PATH "./tests/bench_baseline"
+
+// NOTE(ariel) Per-item lookups only visit the first items of a feed so they
+// measure the lookup itself rather than cache misses across a huge tree.
+enum { MAX_BENCH_ITEMS = 4096 };
+
+typedef struct benchmark benchmark;
+struct benchmark
+{
+	char Name[64];
+	string Source;
+
+	arena Arena;
+	arena_checkpoint Start;
+	RSS_Tree *Tree;
+
+	s32 ItemCount;
+	RSS_Tree_Node **Items;
+	s32 DateCount;
+	string *Dates;
+	u64 Sink;
+};
+
+typedef struct result result;
+struct result
+{
+	char Name[64];
+	s32 Bytes;
+	s32 ItemCount;
+	f64 ParseMegabytesPerSecond;
+	f64 ParseNanosecondsPerItem;
+	u64 ArenaBytes;
+	f64 FeedTitleNanoseconds;
+	f64 LinkNanosecondsPerItem;
+	f64 DateNanosecondsPerItem;
+};
+
+static f64
+Now(void)
+{
+	struct timespec Time = {0};
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	f64 Seconds = (f64)Time.tv_sec + (f64)Time.tv_nsec*1e-9;
+	return Seconds;
+}
+
+static f64
+TimeFastestRun(void (*Procedure)(benchmark *), benchmark *Benchmark)
+{
+	// NOTE(ariel) Keep the fastest of several runs since noise only ever slows a
+	// run down.
+	f64 Fastest = 1e30;
+	f64 Total = 0;
+	for(s32 Run = 0; Run < 5 || (Total < 0.25 && Run < 10000); Run += 1)
+	{
+		f64 Start = Now();
+		Procedure(Benchmark);
+		f64 Elapsed = Now() - Start;
+		Fastest = MIN(Fastest, Elapsed);
+		Total += Elapsed;
+	}
+	return Fastest;
+}
+
+static void
+BenchParse(benchmark *Benchmark)
+{
+	RestoreArenaFromCheckpoint(Benchmark->Start);
+	Benchmark->Tree = parse_rss(&Benchmark->Arena, Benchmark->Source);
+}
+
+enum { FEED_TITLE_CALLS = 1000 };
+
+static void
+BenchFindFeedTitle(benchmark *Benchmark)
+{
+	for(s32 Call = 0; Call < FEED_TITLE_CALLS; Call += 1)
+	{
+		RSS_Tree_Node *Title = find_feed_title(&Benchmark->Arena, Benchmark->Tree->root);
+		Benchmark->Sink += (uintptr)Title;
+	}
+}
+
+static void
+BenchFindLink(benchmark *Benchmark)
+{
+	for(s32 Index = 0; Index < Benchmark->ItemCount; Index += 1)
+	{
+		string Link = find_link(Benchmark->Items[Index]);
+		Benchmark->Sink += Link.len;
+	}
+}
+
+static void
+BenchParseDateTime(benchmark *Benchmark)
+{
+	for(s32 Index = 0; Index < Benchmark->DateCount; Index += 1)
+	{
+		Timestamp Time = parse_date_time(Benchmark->Dates[Index]);
+		Benchmark->Sink += Time.unix_format;
+	}
+}
+
+static void
+CollectItems(benchmark *Benchmark)
+{
+	Benchmark->Items = PushArrayToArena(&Benchmark->Arena, RSS_Tree_Node *, MAX_BENCH_ITEMS);
+	Benchmark->Dates = PushArrayToArena(&Benchmark->Arena, string, MAX_BENCH_ITEMS);
+
+	RSS_Tree_Node *ItemNode = find_item_node(&Benchmark->Arena, Benchmark->Tree->root);
+	for(; ItemNode && Benchmark->ItemCount < MAX_BENCH_ITEMS; ItemNode = ItemNode->next_sibling)
+	{
+		if(!is_item_name(ItemNode->name_id))
+		{
+			continue;
+		}
+
+		Benchmark->Items[Benchmark->ItemCount++] = ItemNode;
+		RSS_Tree_Node *Date = find_item_child_node(ItemNode, RSS_NAME_UPDATED);
+		if(!Date)
+		{
+			Date = find_item_child_node(ItemNode, RSS_NAME_PUB_DATE);
+		}
+		if(Date)
+		{
+			Benchmark->Dates[Benchmark->DateCount++] = string_trim_spaces(Date->content);
+		}
+	}
+}
+
+static s32
+CountItems(benchmark *Benchmark)
+{
+	s32 ItemCount = 0;
+	RSS_Tree_Node *ItemNode = find_item_node(&Benchmark->Arena, Benchmark->Tree->root);
+	for(; ItemNode; ItemNode = ItemNode->next_sibling)
+	{
+		ItemCount += is_item_name(ItemNode->name_id);
+	}
+	return ItemCount;
+}
+
+static result
+RunBenchmark(char *Name, string Source)
+{
+	benchmark Benchmark = { .Source = Source };
+	InitializeArena(&Benchmark.Arena);
+	Benchmark.Start = SetArenaCheckpoint(&Benchmark.Arena);
+
+	result Result = { .Bytes = Source.len };
+	snprintf(Result.Name, sizeof(Result.Name), "%s", Name);
+
+	f64 ParseSeconds = TimeFastestRun(BenchParse, &Benchmark);
+	Result.ArenaBytes = Benchmark.Arena.CurrentOffset - Benchmark.Start.CurrentOffset;
+	Result.ParseMegabytesPerSecond = (f64)Source.len / ParseSeconds / 1e6;
+
+	CollectItems(&Benchmark);
+	Result.ItemCount = CountItems(&Benchmark);
+	Result.ParseNanosecondsPerItem = ParseSeconds*1e9 / MAX(Result.ItemCount, 1);
+	Result.FeedTitleNanoseconds = TimeFastestRun(BenchFindFeedTitle, &Benchmark)*1e9 / FEED_TITLE_CALLS;
+	Result.LinkNanosecondsPerItem = TimeFastestRun(BenchFindLink, &Benchmark)*1e9 / MAX(Benchmark.ItemCount, 1);
+	Result.DateNanosecondsPerItem = TimeFastestRun(BenchParseDateTime, &Benchmark)*1e9 / MAX(Benchmark.DateCount, 1);
+
+	ReleaseArena(&Benchmark.Arena);
+	return Result;
+}
+
+typedef enum synthetic_kind synthetic_kind;
+enum synthetic_kind
+{
+	SYNTHETIC_FLAT,
+	SYNTHETIC_DEEP,
+	SYNTHETIC_CDATA,
+	SYNTHETIC_KIND_COUNT,
+};
+
+global char *SyntheticKindNames[SYNTHETIC_KIND_COUNT] =
+{
+	[SYNTHETIC_FLAT] = "flat",
+	[SYNTHETIC_DEEP] = "deep",
+	[SYNTHETIC_CDATA] = "cdata",
+};
+
+static void
+AppendString(arena *Arena, string *Source, char *Format, ...)
+{
+	char Buffer[1024];
+	va_list Arguments;
+	va_start(Arguments, Format);
+	s32 Length = vsnprintf(Buffer, sizeof(Buffer), Format, Arguments);
+	va_end(Arguments);
+	AssertAlways(Length > 0 && Length < (s32)sizeof(Buffer));
+
+	Source->str = ReallocFromArena(Arena, Source->len + Length);
+	memcpy(Source->str + Source->len, Buffer, Length);
+	Source->len += Length;
+}
+
+static string
+GenerateSyntheticFeed(arena *Arena, synthetic_kind Kind, s32 TargetBytes)
+{
+	// NOTE(ariel) The feed only grows by ReallocFromArena(), so nothing else may
+	// push to the arena until it's complete. Start from an empty allocation so
+	// the first reallocation doesn't clobber whatever the arena held last.
+	string Source = { .str = PushBytesToArena(Arena, 0) };
+	AppendString(Arena, &Source,
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<rss version=\"2.0\" xmlns:atom=\"http://www.w3.org/2005/Atom\">\n<channel>\n"
+		"\t<title>Synthetic %s feed</title>\n"
+		"\t<link>https://example.com/</link>\n"
+		"\t<atom:link href=\"https://example.com/feed.xml\" rel=\"self\" type=\"application/rss+xml\"/>\n",
+		SyntheticKindNames[Kind]);
+
+	char *Closing = "</channel>\n</rss>\n";
+	s32 ClosingLength = (s32)strlen(Closing);
+	for(s32 Index = 0; Source.len + ClosingLength < TargetBytes; Index += 1)
+	{
+		AppendString(Arena, &Source,
+			"\t<item>\n"
+			"\t\t<title>Item number %d</title>\n"
+			"\t\t<link>https://example.com/posts/%d</link>\n"
+			"\t\t<guid isPermaLink=\"true\">https://example.com/posts/%d</guid>\n"
+			"\t\t<pubDate>Sun, %02d May 2023 19:%02d:11 GMT</pubDate>\n",
+			Index, Index, Index, 1 + Index % 28, Index % 60);
+
+		switch(Kind)
+		{
+			case SYNTHETIC_FLAT:
+			{
+				AppendString(Arena, &Source,
+					"\t\t<description>A short summary of item %d &amp; its contents.</description>\n", Index);
+			} break;
+			case SYNTHETIC_DEEP:
+			{
+				AppendString(Arena, &Source, "\t\t<content>");
+				for(s32 Depth = 0; Depth < 24; Depth += 1)
+				{
+					AppendString(Arena, &Source, "<div class=\"level-%d\">", Depth);
+				}
+				AppendString(Arena, &Source, "nested %d", Index);
+				for(s32 Depth = 0; Depth < 24; Depth += 1)
+				{
+					AppendString(Arena, &Source, "</div>");
+				}
+				AppendString(Arena, &Source, "</content>\n");
+			} break;
+			case SYNTHETIC_CDATA:
+			{
+				AppendString(Arena, &Source, "\t\t<description><![CDATA[");
+				for(s32 Paragraph = 0; Paragraph < 8; Paragraph += 1)
+				{
+					AppendString(Arena, &Source,
+						"<p>Paragraph %d of item %d holds <a href=\"https://example.com/\">markup</a>, "
+						"<em>emphasis</em>, and text that the parser must skip in one scan.</p>\n",
+						Paragraph, Index);
+				}
+				AppendString(Arena, &Source, "]]></description>\n");
+			} break;
+			default: AssertAlways(!"unreachable");
+		}
+
+		AppendString(Arena, &Source, "\t</item>\n");
+	}
+	AppendString(Arena, &Source, "%s", Closing);
+
+	return Source;
+}
+
+static string
+LoadFile(arena *Arena, char *FilePath)
+{
+	string Contents = {0};
+
+	FILE *File = fopen(FilePath, "rb");
+	AssertAlways(File);
+	fseek(File, 0l, SEEK_END);
+	Contents.len = (s32)ftell(File);
+	rewind(File);
+
+	Contents.str = PushBytesToArena(Arena, Contents.len);
+	size_t Length = fread(Contents.str, Contents.len, sizeof(char), File);
+	if(!Length)
+	{
+		Contents.str = 0;
+		Contents.len = 0;
+	}
+	fclose(File);
+
+	return Contents;
+}
+
+static void
+PrintResult(result *Result)
+{
+	printf("%-32s %10d %8d %10.1f %10.1f %12llu %10.1f %10.1f %10.1f\n",
+		Result->Name, Result->Bytes, Result->ItemCount,
+		Result->ParseMegabytesPerSecond, Result->ParseNanosecondsPerItem,
+		(unsigned long long)Result->ArenaBytes, Result->FeedTitleNanoseconds,
+		Result->LinkNanosecondsPerItem, Result->DateNanosecondsPerItem);
+}
+
+static b32
+IsRegression(char *Name, char *Metric, f64 Baseline, f64 Actual, b32 HigherIsBetter, f64 Tolerance, b32 ShouldReport)
+{
+	b32 Regressed = HigherIsBetter
+		? Actual < Baseline*(1.0 - Tolerance)
+		: Actual > Baseline*(1.0 + Tolerance);
+	if(Regressed && ShouldReport)
+	{
+		fprintf(stderr, "regression: %s %s %.1f (baseline %.1f)\n", Name, Metric, Actual, Baseline);
+	}
+	return Regressed;
+}
+
+static s32
+CountRegressions(result *Result, result *Baseline, f64 Tolerance, b32 ShouldReport)
+{
+	s32 RegressionCount = 0;
+	if(Baseline)
+	{
+		RegressionCount += IsRegression(Result->Name, "parse MB/s",
+			Baseline->ParseMegabytesPerSecond, Result->ParseMegabytesPerSecond, true, Tolerance, ShouldReport);
+		RegressionCount += IsRegression(Result->Name, "arena bytes",
+			(f64)Baseline->ArenaBytes, (f64)Result->ArenaBytes, false, Tolerance, ShouldReport);
+		RegressionCount += IsRegression(Result->Name, "feed title ns",
+			Baseline->FeedTitleNanoseconds, Result->FeedTitleNanoseconds, false, Tolerance, ShouldReport);
+		RegressionCount += IsRegression(Result->Name, "link ns/item",
+			Baseline->LinkNanosecondsPerItem, Result->LinkNanosecondsPerItem, false, Tolerance, ShouldReport);
+		RegressionCount += IsRegression(Result->Name, "date ns/item",
+			Baseline->DateNanosecondsPerItem, Result->DateNanosecondsPerItem, false, Tolerance, ShouldReport);
+	}
+	return RegressionCount;
+}
+
+enum { MAX_RESULTS = 64 };
+
+typedef struct baseline baseline;
+struct baseline
+{
+	s32 Count;
+	result Results[MAX_RESULTS];
+};
+
+static void
+LoadBaseline(baseline *Baseline)
+{
+	FILE *File = fopen(BASELINE_PATH, "r");
+	if(File)
+	{
+		result Result = {0};
+		unsigned long long ArenaBytes = 0;
+		while(Baseline->Count < MAX_RESULTS && fscanf(File, "%63s %lf %llu %lf %lf %lf",
+			Result.Name, &Result.ParseMegabytesPerSecond, &ArenaBytes,
+			&Result.FeedTitleNanoseconds, &Result.LinkNanosecondsPerItem,
+			&Result.DateNanosecondsPerItem) == 6)
+		{
+			Result.ArenaBytes = ArenaBytes;
+			Baseline->Results[Baseline->Count++] = Result;
+		}
+		fclose(File);
+	}
+}
+
+static result *
+FindBaselineResult(baseline *Baseline, char *Name)
+{
+	result *Result = 0;
+	for(s32 Index = 0; Index < Baseline->Count; Index += 1)
+	{
+		if(strcmp(Baseline->Results[Index].Name, Name) == 0)
+		{
+			Result = &Baseline->Results[Index];
+			break;
+		}
+	}
+	return Result;
+}
+
+static void
+WriteBaseline(result *Results, s32 ResultCount)
+{
+	FILE *File = fopen(BASELINE_PATH, "w");
+	AssertAlways(File);
+	for(s32 Index = 0; Index < ResultCount; Index += 1)
+	{
+		result *Result = &Results[Index];
+		fprintf(File, "%s %.1f %llu %.1f %.1f %.1f\n",
+			Result->Name, Result->ParseMegabytesPerSecond, (unsigned long long)Result->ArenaBytes,
+			Result->FeedTitleNanoseconds, Result->LinkNanosecondsPerItem, Result->DateNanosecondsPerItem);
+	}
+	fclose(File);
+}
+
+static result
+RunBenchmarkAgainstBaseline(char *Name, string Source, baseline *Baseline, f64 Tolerance)
+{
+	result Result = RunBenchmark(Name, Source);
+
+	// NOTE(ariel) A noisy neighbor can slow any single measurement, so measure a
+	// case that looks like it regressed again and keep the best of each metric
+	// before believing it.
+	result *Expected = FindBaselineResult(Baseline, Name);
+	for(s32 Retry = 0; Retry < 2 && CountRegressions(&Result, Expected, Tolerance, false); Retry += 1)
+	{
+		result Again = RunBenchmark(Name, Source);
+		Result.ParseMegabytesPerSecond = MAX(Result.ParseMegabytesPerSecond, Again.ParseMegabytesPerSecond);
+		Result.ParseNanosecondsPerItem = MIN(Result.ParseNanosecondsPerItem, Again.ParseNanosecondsPerItem);
+		Result.FeedTitleNanoseconds = MIN(Result.FeedTitleNanoseconds, Again.FeedTitleNanoseconds);
+		Result.LinkNanosecondsPerItem = MIN(Result.LinkNanosecondsPerItem, Again.LinkNanosecondsPerItem);
+		Result.DateNanosecondsPerItem = MIN(Result.DateNanosecondsPerItem, Again.DateNanosecondsPerItem);
+	}
+
+	PrintResult(&Result);
+	return Result;
+}
+
+int
+main(int ArgumentCount, char **Arguments)
+{
+	b32 ShouldUpdateBaseline = false;
+	f64 Tolerance = DEFAULT_TOLERANCE;
+	for(s32 Index = 1; Index < ArgumentCount; Index += 1)
+	{
+		if(strcmp(Arguments[Index], "--update") == 0)
+		{
+			ShouldUpdateBaseline = true;
+		}
+		else if(strcmp(Arguments[Index], "--tolerance") == 0 && Index + 1 < ArgumentCount)
+		{
+			Tolerance = atof(Arguments[++Index]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--update] [--tolerance FRACTION]\n", Arguments[0]);
+			return 2;
+		}
+	}
+
+	baseline Baseline = {0};
+	if(!ShouldUpdateBaseline)
+	{
+		LoadBaseline(&Baseline);
+		if(!Baseline.Count)
+		{
+			fprintf(stderr, "no baseline at %s; run with --update to write one\n", BASELINE_PATH);
+			return 1;
+		}
+	}
+
+	arena Arena = {0};
+	InitializeArena(&Arena);
+
+	static result Results[MAX_RESULTS] = {0};
+	s32 ResultCount = 0;
+
+	printf("%-32s %10s %8s %10s %10s %12s %10s %10s %10s\n",
+		"benchmark", "bytes", "items", "parse MB/s", "ns/item", "arena bytes",
+		"title ns", "link ns", "date ns");
+
+	DIR *Inputs = opendir("./tests/inputs");
+	AssertAlways(Inputs);
+	struct dirent *Input = 0;
+	while((Input = readdir(Inputs)) && ResultCount < MAX_RESULTS)
+	{
+		if(Input->d_type == DT_REG)
+		{
+			arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+
+			static char InputFilePath[1024];
+			snprintf(InputFilePath, sizeof(InputFilePath), "%s/%s", "./tests/inputs", Input->d_name);
+			string Source = LoadFile(&Arena, InputFilePath);
+			Results[ResultCount++] = RunBenchmarkAgainstBaseline(Input->d_name, Source, &Baseline, Tolerance);
+
+			RestoreArenaFromCheckpoint(Checkpoint);
+		}
+	}
+	closedir(Inputs);
+
+	s32 SyntheticSizes[] = { KB(1), KB(64), MB(1), MB(50) };
+	for(synthetic_kind Kind = 0; Kind < SYNTHETIC_KIND_COUNT; Kind += 1)
+	{
+		for(s32 Index = 0; Index < (s32)ARRAY_COUNT(SyntheticSizes) && ResultCount < MAX_RESULTS; Index += 1)
+		{
+			arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+
+			char Name[64];
+			snprintf(Name, sizeof(Name), "synthetic-%s-%dKB", SyntheticKindNames[Kind], SyntheticSizes[Index] >> 10);
+			string Source = GenerateSyntheticFeed(&Arena, Kind, SyntheticSizes[Index]);
+			Results[ResultCount++] = RunBenchmarkAgainstBaseline(Name, Source, &Baseline, Tolerance);
+
+			RestoreArenaFromCheckpoint(Checkpoint);
+		}
+	}
+
+	s32 Status = 0;
+	if(ShouldUpdateBaseline)
+	{
+		WriteBaseline(Results, ResultCount);
+		printf("wrote baseline to %s\n", BASELINE_PATH);
+	}
+	else
+	{
+		s32 RegressionCount = 0;
+		for(s32 Index = 0; Index < ResultCount; Index += 1)
+		{
+			result *Expected = FindBaselineResult(&Baseline, Results[Index].Name);
+			RegressionCount += CountRegressions(&Results[Index], Expected, Tolerance, true);
+		}
+		Status = RegressionCount > 0;
+		printf("%d regression(s) past %.0f%% of baseline\n", RegressionCount, Tolerance*100.0);
+	}
+
+	ReleaseArena(&Arena);
+	return Status;
+}
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+
+# NOTE(ariel) Serve the files in tests/inputs compressed ahead of time as a
+# stand-in for feeds on the network. A request for /<encoding>/<name> receives
+# <name> compressed with <encoding> if the client accepts it. /bomb/<size>
+# receives <size> zeros compressed with gzip. /trickle/<name> receives <name>
+# uncompressed in chunks of one byte each. Fixtures carry an ETag and a
+# Last-Modified date and answer conditional requests that match them with 304.
+
+import email.utils
+import gzip
+import http.server
+import os
+import shutil
+import subprocess
+import sys
+import zlib
+
+INPUTS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "inputs")
+
+def compress_with_tool(tool, data):
+	if not shutil.which(tool):
+		return None
+	return subprocess.run([tool, "-c", "-q"], input=data, stdout=subprocess.PIPE, check=True).stdout
+
+COMPRESSORS = {
+	"identity": lambda data: data,
+	"gzip": lambda data: gzip.compress(data),
+	"deflate": lambda data: zlib.compress(data),
+	"br": lambda data: compress_with_tool("brotli", data),
+	"zstd": lambda data: compress_with_tool("zstd", data),
+}
+
+FIXTURES = {}
+VALIDATORS = {}
+for name in sorted(os.listdir(INPUTS)):
+	path = os.path.join(INPUTS, name)
+	with open(path, "rb") as f:
+		data = f.read()
+	last_modified = email.utils.formatdate(os.path.getmtime(path), usegmt=True)
+	for encoding, compress in COMPRESSORS.items():
+		compressed = compress(data)
+		if compressed is not None:
+			FIXTURES[(encoding, name)] = compressed
+			VALIDATORS[(encoding, name)] = ('"%08x"' % zlib.crc32(compressed), last_modified)
+
+class Handler(http.server.BaseHTTPRequestHandler):
+	# NOTE(ariel) Keep connections open between requests so that clients may
+	# reuse them.
+	protocol_version = "HTTP/1.1"
+
+	def do_GET(self):
+		parts = self.path.strip("/").split("/")
+		accepted = [e.split(";")[0].strip() for e in self.headers.get("Accept-Encoding", "").split(",")]
+		body = None
+		validators = None
+		encoding = parts[0] if parts else ""
+		if len(parts) == 2 and encoding == "trickle" and ("identity", parts[1]) in FIXTURES:
+			self.send_response(200)
+			self.send_header("Content-Type", "application/xml")
+			self.send_header("Transfer-Encoding", "chunked")
+			self.end_headers()
+			for byte in FIXTURES[("identity", parts[1])]:
+				self.wfile.write(b"1\r\n" + bytes([byte]) + b"\r\n")
+			self.wfile.write(b"0\r\n\r\n")
+			return
+		elif len(parts) == 2 and encoding == "bomb":
+			body = gzip.compress(bytes(int(parts[1])))
+			encoding = "gzip"
+		elif len(parts) == 2 and (encoding, parts[1]) in FIXTURES and (encoding == "identity" or encoding in accepted):
+			body = FIXTURES[(encoding, parts[1])]
+			validators = VALIDATORS[(encoding, parts[1])]
+
+		if body is None:
+			# NOTE(ariel) send_error() closes the connection.
+			self.send_response(404)
+			self.send_header("Content-Length", "0")
+			self.end_headers()
+			return
+
+		if validators:
+			etag, last_modified = validators
+			# NOTE(ariel) If-None-Match takes precedence over If-Modified-Since.
+			if_none_match = self.headers.get("If-None-Match")
+			if_modified_since = self.headers.get("If-Modified-Since")
+			if (if_none_match == etag) or (if_none_match is None and if_modified_since == last_modified):
+				self.send_response(304)
+				self.send_header("ETag", etag)
+				self.send_header("Last-Modified", last_modified)
+				self.end_headers()
+				return
+
+		self.send_response(200)
+		self.send_header("Content-Type", "application/xml")
+		if validators:
+			self.send_header("ETag", validators[0])
+			self.send_header("Last-Modified", validators[1])
+		if encoding != "identity":
+			self.send_header("Content-Encoding", encoding)
+		self.send_header("Content-Length", str(len(body)))
+		self.end_headers()
+		self.wfile.write(body)
+
+	def log_message(self, format, *args):
+		pass
+
+port = int(sys.argv[1]) if len(sys.argv) > 1 else 8937
+server = http.server.ThreadingHTTPServer(("127.0.0.1", port), Handler)
+print("serving fixtures on port %d" % port, flush=True)
+server.serve_forever()
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+
+# NOTE(ariel) Serve responses the fetch engine recorded as a stand-in for feeds
+# on the network. A request for /<name> receives the recording named <name>:
+# its status, its headers, and its body. Recordings hold decompressed bodies,
+# so the server drops headers that describe how the original traveled. It
+# waits --latency milliseconds before it responds and sends bodies no faster
+# than --bandwidth kilobytes per second so that benchmarks see the same network
+# on every run.
+
+import argparse
+import http.server
+import os
+import time
+
+# NOTE(ariel) The server frames and encodes bodies itself.
+DROPPED_HEADERS = { "connection", "content-encoding", "content-length", "keep-alive", "transfer-encoding" }
+
+def load_recording(path):
+	with open(path, "rb") as f:
+		data = f.read()
+	head, _, body = data.partition(b"\r\n\r\n")
+	lines = head.decode("latin-1").split("\r\n")
+	status = int(lines[0].split()[1])
+	headers = []
+	for line in lines[1:]:
+		name, _, value = line.partition(":")
+		if name.strip().lower() not in DROPPED_HEADERS:
+			headers.append((name.strip(), value.strip()))
+	return status, headers, body
+
+parser = argparse.ArgumentParser()
+parser.add_argument("directory")
+parser.add_argument("--port", type=int, default=8938)
+parser.add_argument("--latency", type=float, default=0, help="milliseconds before each response")
+parser.add_argument("--bandwidth", type=float, default=0, help="kilobytes per second per response, 0 for no limit")
+options = parser.parse_args()
+
+RECORDINGS = {}
+for name in sorted(os.listdir(options.directory)):
+	RECORDINGS[name] = load_recording(os.path.join(options.directory, name))
+
+class Handler(http.server.BaseHTTPRequestHandler):
+	protocol_version = "HTTP/1.1"
+
+	def do_GET(self):
+		time.sleep(options.latency / 1000)
+
+		recording = RECORDINGS.get(self.path.strip("/"))
+		if recording is None:
+			self.send_response(404)
+			self.send_header("Content-Length", "0")
+			self.end_headers()
+			return
+
+		status, headers, body = recording
+		lookup = { name.lower(): value for name, value in headers }
+		if status == 200:
+			# NOTE(ariel) If-None-Match takes precedence over If-Modified-Since.
+			if_none_match = self.headers.get("If-None-Match")
+			if_modified_since = self.headers.get("If-Modified-Since")
+			etag = lookup.get("etag")
+			last_modified = lookup.get("last-modified")
+			if (if_none_match and if_none_match == etag) or (if_none_match is None and if_modified_since and if_modified_since == last_modified):
+				status = 304
+				body = b""
+
+		self.send_response(status)
+		for name, value in headers:
+			self.send_header(name, value)
+		self.send_header("Content-Length", str(len(body)))
+		self.end_headers()
+
+		if options.bandwidth > 0:
+			# NOTE(ariel) Send a twentieth of a second's worth at a time.
+			chunk_size = max(1, int(options.bandwidth * 1024 / 20))
+			for offset in range(0, len(body), chunk_size):
+				self.wfile.write(body[offset:offset + chunk_size])
+				self.wfile.flush()
+				time.sleep(0.05)
+		else:
+			self.wfile.write(body)
+
+	def log_message(self, format, *args):
+		pass
+
+server = http.server.ThreadingHTTPServer(("127.0.0.1", options.port), Handler)
+print("replaying %d recordings on port %d" % (len(RECORDINGS), options.port), flush=True)
+server.serve_forever()
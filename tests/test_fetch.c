@@ -0,0 +1,423 @@
+#include <dirent.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+
+#include "base.h"
+#include "memory.h"
+#include "arena.h"
+#include "str.h"
+#include "encoding.h"
+#include "rss.h"
+#include "fetch.h"
+
+#if defined(__linux__)
+#include "memory_linux.c"
+#elif defined(_WIN64)
+#include "memory_windows.c"
+#else
+#error `memory.h` is not implemented on this platform.
+#endif
+#include "arena.c"
+#include "str.c"
+#include "encoding.c"
+#include "rss.c"
+#include "fetch.c"
+
+// NOTE(ariel) This test expects tests/fixture_server.py to serve the inputs at
+// the address passed as its only argument.
+
+static string
+LoadFile(arena *Arena, char *FilePath)
+{
+	string Contents = {0};
+
+	FILE *File = fopen(FilePath, "rb");
+	AssertAlways(File);
+	fseek(File, 0l, SEEK_END);
+	Contents.len = (s32)ftell(File);
+	rewind(File);
+
+	Contents.str = PushBytesToArena(Arena, Contents.len);
+	size_t Length = fread(Contents.str, Contents.len, sizeof(char), File);
+	if(!Length)
+	{
+		Contents.str = 0;
+		Contents.len = 0;
+	}
+	fclose(File);
+
+	return Contents;
+}
+
+static CURLcode
+Fetch(curl_response *Response, char *Address, char *Path)
+{
+	char URL[1024];
+	snprintf(URL, sizeof(URL), "%s/%s", Address, Path);
+
+	PrepareFetch(Response, URL);
+	CURLcode CurlResult = curl_easy_perform(Response->CurlHandle);
+	FinishFetch(Response);
+	return CurlResult;
+}
+
+static long
+FetchConditionally(curl_response *Response, char *Address, char *Path, fetch_validators Validators)
+{
+	char URL[1024];
+	snprintf(URL, sizeof(URL), "%s/%s", Address, Path);
+
+	PrepareFetch(Response, URL);
+	struct curl_slist *Headers = AppendConditionalHeaders(0, Validators);
+	curl_easy_setopt(Response->CurlHandle, CURLOPT_HTTPHEADER, Headers);
+	CURLcode CurlResult = curl_easy_perform(Response->CurlHandle);
+	AssertAlways(CurlResult == CURLE_OK);
+	FinishFetch(Response);
+
+	long HTTPResponseCode = 0;
+	curl_easy_getinfo(Response->CurlHandle, CURLINFO_RESPONSE_CODE, &HTTPResponseCode);
+	curl_easy_reset(Response->CurlHandle);
+	curl_slist_free_all(Headers);
+	return HTTPResponseCode;
+}
+
+typedef struct expected_fetch expected_fetch;
+struct expected_fetch
+{
+	string Data;
+	b32 Fetched;
+};
+
+global fetch_engine Engine;
+global _Atomic s32 CompletedFetchCount;
+global _Atomic s32 NewConnectionCount;
+global s32 PeakInFlightCount;
+
+static void
+CheckCompletedFetch(fetch_transfer *Transfer)
+{
+	expected_fetch *Expected = Transfer->UserData;
+	AssertAlways(Transfer->Result == CURLE_OK);
+	AssertAlways(Transfer->HTTPResponseCode == 200 || Transfer->HTTPResponseCode == 404);
+	if(Transfer->HTTPResponseCode == 200)
+	{
+		AssertAlways(string_match(Transfer->Response.Data, Expected->Data));
+		Expected->Fetched = true;
+	}
+
+	long ConnectionCount = 0;
+	curl_easy_getinfo(Transfer->CurlHandle, CURLINFO_NUM_CONNECTS, &ConnectionCount);
+	NewConnectionCount += (s32)ConnectionCount;
+
+	// NOTE(ariel) The engine calls this on its own thread, the only one that
+	// touches `InFlight`, just after this transfer finished.
+	s32 InFlightCount = 1;
+	for(s32 Index = 0; Index < Engine.MaxTransferCount; Index += 1)
+	{
+		InFlightCount += Engine.Transfers[Index].InFlight;
+	}
+	PeakInFlightCount = MAX(PeakInFlightCount, InFlightCount);
+
+	ReleaseTransfer(&Engine, Transfer);
+	CompletedFetchCount += 1;
+}
+
+// NOTE(ariel) Record the order requests finish in and hold their transfers, so
+// that the test decides when each transfer frees up.
+global fetch_engine PriorityEngine;
+global fetch_transfer *_Atomic HeldTransfers[8];
+global char *HeldNames[8];
+global _Atomic s32 HeldTransferCount;
+
+static void
+HoldCompletedFetch(fetch_transfer *Transfer)
+{
+	AssertAlways(Transfer->Result == CURLE_OK);
+	s32 Index = atomic_fetch_add(&HeldTransferCount, 1);
+	AssertAlways(Index < (s32)ARRAY_COUNT(HeldTransfers));
+	HeldNames[Index] = Transfer->UserData;
+	HeldTransfers[Index] = Transfer;
+}
+
+static void
+WaitForHeldTransfers(s32 Count)
+{
+	while(HeldTransferCount < Count || !HeldTransfers[Count - 1])
+	{
+		usleep(1000);
+	}
+}
+
+int
+main(int ArgumentCount, char **Arguments)
+{
+	AssertAlways(ArgumentCount == 2);
+	char *Address = Arguments[1];
+
+	// NOTE(ariel) Responses hold their bodies outside of arenas. The parser
+	// places nodes in its own arena to clear after each response.
+	arena Arena = {0};
+	arena ParserArena = {0};
+	InitializeArena(&Arena);
+	InitializeArena(&ParserArena);
+
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+	CURL *CurlHandle = curl_easy_init(); AssertAlways(CurlHandle);
+
+	char *Encodings[] = { "identity", "gzip", "deflate", "br", "zstd" };
+	s32 FetchCounts[ARRAY_COUNT(Encodings)] = {0};
+	s32 SpilledCount = 0;
+
+	DIR *Inputs = opendir("./tests/inputs");
+	AssertAlways(Inputs);
+	struct dirent *Input = 0;
+	while((Input = readdir(Inputs)))
+	{
+		if(Input->d_type != DT_REG)
+		{
+			continue;
+		}
+
+		arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+
+		static char InputFilePath[1024];
+		snprintf(InputFilePath, sizeof(InputFilePath), "%s/%s", "./tests/inputs", Input->d_name);
+		string Bytes = LoadFile(&Arena, InputFilePath);
+		string Expected = transcode_document_to_utf8(&Arena, Bytes, (string){0});
+
+		// NOTE(ariel) Every encoding decompresses to the same body in differently
+		// sized pieces, and each must hash it the same way.
+		u64 BodyHash = 0;
+		for(s32 Index = 0; Index < (s32)ARRAY_COUNT(Encodings); Index += 1)
+		{
+			// NOTE(ariel) Larger inputs move onto a file partway through.
+			curl_response Response = { .CurlHandle = CurlHandle, .Arena = &Arena, .SpillThreshold = KB(64) };
+
+			static char Path[1024];
+			snprintf(Path, sizeof(Path), "%s/%s", Encodings[Index], Input->d_name);
+			CURLcode CurlResult = Fetch(&Response, Address, Path);
+			AssertAlways(CurlResult == CURLE_OK);
+
+			long HTTPResponseCode = 0;
+			curl_easy_getinfo(CurlHandle, CURLINFO_RESPONSE_CODE, &HTTPResponseCode);
+			curl_easy_reset(CurlHandle);
+			if(HTTPResponseCode == 404)
+			{
+				// NOTE(ariel) Either the server or libcurl lacks this encoding.
+				ReleaseResponse(&Response);
+				continue;
+			}
+			AssertAlways(HTTPResponseCode == 200);
+
+			AssertAlways(string_match(Response.Data, Expected));
+			AssertAlways(Response.DecompressedByteCount == Bytes.len);
+			AssertAlways(Response.Spilled || Response.Data.len <= KB(64));
+			SpilledCount += Response.Spilled;
+			if(Index > 0 && Bytes.len >= KB(4))
+			{
+				AssertAlways(Response.CompressedByteCount < Response.DecompressedByteCount);
+			}
+
+			RSS_Tree *Tree = parse_rss(&ParserArena, Response.Data);
+			AssertAlways(!Tree->errors.first);
+
+			AssertAlways(Response.BodyHash);
+			AssertAlways(!BodyHash || Response.BodyHash == BodyHash);
+			BodyHash = Response.BodyHash;
+
+			// NOTE(ariel) Either validator alone must spare the body of a response
+			// that hasn't changed, and a stale one must not.
+			AssertAlways(Response.ETag.len > 0);
+			AssertAlways(Response.LastModified.len > 0);
+			fetch_validators ValidatorsToTry[] =
+			{
+				{ .ETag = Response.ETag },
+				{ .LastModified = Response.LastModified },
+				{ .ETag = string_literal("\"stale\""), .LastModified = Response.LastModified },
+			};
+			long ExpectedResponseCodes[] = { 304, 304, 200 };
+			for(s32 ValidatorIndex = 0; ValidatorIndex < (s32)ARRAY_COUNT(ValidatorsToTry); ValidatorIndex += 1)
+			{
+				curl_response ConditionalResponse = { .CurlHandle = CurlHandle, .Arena = &Arena };
+				long ConditionalResponseCode = FetchConditionally(&ConditionalResponse, Address, Path, ValidatorsToTry[ValidatorIndex]);
+				AssertAlways(ConditionalResponseCode == ExpectedResponseCodes[ValidatorIndex]);
+				if(ConditionalResponseCode == 304)
+				{
+					AssertAlways(ConditionalResponse.Data.len == 0);
+					AssertAlways(string_match(ConditionalResponse.ETag, Response.ETag));
+				}
+				else
+				{
+					AssertAlways(string_match(ConditionalResponse.Data, Expected));
+					AssertAlways(ConditionalResponse.BodyHash == BodyHash);
+				}
+				ReleaseResponse(&ConditionalResponse);
+			}
+
+			printf("%-10s %-28s %10lld bytes received, %10lld bytes decompressed\n",
+				Encodings[Index], Input->d_name,
+				(long long)Response.CompressedByteCount, (long long)Response.DecompressedByteCount);
+			FetchCounts[Index] += 1;
+			ReleaseResponse(&Response);
+			ClearArena(&ParserArena);
+		}
+		AssertAlways(HashBody(Bytes) == BodyHash);
+
+		RestoreArenaFromCheckpoint(Checkpoint);
+	}
+	closedir(Inputs);
+
+	AssertAlways(FetchCounts[0] > 0);
+	AssertAlways(SpilledCount > 0);
+	AssertAlways(FetchCounts[1] == FetchCounts[0]);
+	AssertAlways(FetchCounts[2] == FetchCounts[0]);
+
+	{
+		// NOTE(ariel) A response that arrives a byte at a time must still find the
+		// encoding its XML declaration names further in.
+		string Expected = transcode_document_to_utf8(&Arena, LoadFile(&Arena, "./tests/inputs/latin1.xml"), (string){0});
+		curl_response Response = { .CurlHandle = CurlHandle, .Arena = &Arena };
+		CURLcode CurlResult = Fetch(&Response, Address, "trickle/latin1.xml");
+		curl_easy_reset(CurlHandle);
+		AssertAlways(CurlResult == CURLE_OK);
+		AssertAlways(string_match(Response.Data, Expected));
+		ReleaseResponse(&Response);
+	}
+
+	{
+		// NOTE(ariel) Fetch every input in every encoding at once through the
+		// engine with fewer transfers than requests, so that most requests wait
+		// for a transfer to free up. Every request goes to the same host, so the
+		// transfers must take turns on as many connections, and keep as many
+		// requests in flight, as the engine allows per host.
+		enum { MAX_EXPECTED_FETCHES = 1024, MAX_TRANSFERS_PER_HOST = 2 };
+		static expected_fetch ExpectedFetches[MAX_EXPECTED_FETCHES];
+		s32 ExpectedFetchCount = 0;
+
+		StartFetchEngine(&Engine, &Arena, 4, MAX_TRANSFERS_PER_HOST, MAX_EXPECTED_FETCHES, CheckCompletedFetch);
+
+		Inputs = opendir("./tests/inputs");
+		AssertAlways(Inputs);
+		while((Input = readdir(Inputs)))
+		{
+			if(Input->d_type != DT_REG)
+			{
+				continue;
+			}
+
+			static char InputFilePath[1024];
+			snprintf(InputFilePath, sizeof(InputFilePath), "%s/%s", "./tests/inputs", Input->d_name);
+			string Expected = transcode_document_to_utf8(&Arena, LoadFile(&Arena, InputFilePath), (string){0});
+			for(s32 Index = 0; Index < (s32)ARRAY_COUNT(Encodings); Index += 1)
+			{
+				AssertAlways(ExpectedFetchCount < MAX_EXPECTED_FETCHES);
+				expected_fetch *ExpectedFetch = &ExpectedFetches[ExpectedFetchCount++];
+				ExpectedFetch->Data = Expected;
+
+				static char URL[1024];
+				snprintf(URL, sizeof(URL), "%s/%s/%s", Address, Encodings[Index], Input->d_name);
+				QueueFetch(&Engine, (string){ .str = URL, .len = (s32)strlen(URL) }, (fetch_validators){0}, FETCH_PRIORITY_BACKGROUND, ExpectedFetch);
+			}
+		}
+		closedir(Inputs);
+
+		while(CompletedFetchCount < ExpectedFetchCount)
+		{
+			usleep(1000);
+		}
+		StopFetchEngine(&Engine);
+
+		s32 FetchedCount = 0;
+		for(s32 Index = 0; Index < ExpectedFetchCount; Index += 1)
+		{
+			FetchedCount += ExpectedFetches[Index].Fetched;
+		}
+		s32 SerialFetchCount = 0;
+		for(s32 Index = 0; Index < (s32)ARRAY_COUNT(Encodings); Index += 1)
+		{
+			SerialFetchCount += FetchCounts[Index];
+		}
+		AssertAlways(FetchedCount == SerialFetchCount);
+		AssertAlways(NewConnectionCount > 0 && NewConnectionCount <= MAX_TRANSFERS_PER_HOST);
+		AssertAlways(PeakInFlightCount <= MAX_TRANSFERS_PER_HOST);
+		printf("fetched %d of %d requests concurrently over %d connections\n",
+			FetchedCount, ExpectedFetchCount, (s32)NewConnectionCount);
+	}
+
+	{
+		// NOTE(ariel) With two transfers, the engine starts one background request
+		// at a time and keeps the other transfer for interactive requests, which
+		// start ahead of requests queued before them, including one promoted from
+		// the background. Each lane starts with room for one request and must grow
+		// to hold the rest.
+		StartFetchEngine(&PriorityEngine, &Arena, 2, 2, 1, HoldCompletedFetch);
+
+		char *Names[] = { "b1", "b2", "b3", "v1", "i1" };
+		fetch_priority Priorities[] = { FETCH_PRIORITY_BACKGROUND, FETCH_PRIORITY_BACKGROUND,
+			FETCH_PRIORITY_BACKGROUND, FETCH_PRIORITY_VISIBLE, FETCH_PRIORITY_INTERACTIVE };
+		string URLs[ARRAY_COUNT(Names)] = {0};
+		for(s32 Index = 0; Index < (s32)ARRAY_COUNT(Names); Index += 1)
+		{
+			char URL[1024];
+			snprintf(URL, sizeof(URL), "%s/priority/%s", Address, Names[Index]);
+			URLs[Index] = string_duplicate(&Arena, (string){ .str = URL, .len = (s32)strlen(URL) });
+		}
+
+		QueueFetch(&PriorityEngine, URLs[0], (fetch_validators){0}, Priorities[0], Names[0]);
+		QueueFetch(&PriorityEngine, URLs[1], (fetch_validators){0}, Priorities[1], Names[1]);
+		WaitForHeldTransfers(1);
+		for(s32 Index = 2; Index < (s32)ARRAY_COUNT(Names); Index += 1)
+		{
+			QueueFetch(&PriorityEngine, URLs[Index], (fetch_validators){0}, Priorities[Index], Names[Index]);
+		}
+		AssertAlways(PromoteFetch(&PriorityEngine, URLs[1], FETCH_PRIORITY_INTERACTIVE));
+		AssertAlways(!PromoteFetch(&PriorityEngine, URLs[0], FETCH_PRIORITY_INTERACTIVE));
+		WaitForHeldTransfers(2);
+
+		// NOTE(ariel) Free every held transfer at once, so that one of them goes to
+		// the next request in line and the other stays reserved.
+		char *ExpectedOrder[] = { "b1", "i1", "b2", "v1", "b3" };
+		s32 ReleasedCount = 0;
+		for(s32 Count = 3; Count <= (s32)ARRAY_COUNT(ExpectedOrder); Count += 1)
+		{
+			for(; ReleasedCount < Count - 1; ReleasedCount += 1)
+			{
+				ReleaseTransfer(&PriorityEngine, HeldTransfers[ReleasedCount]);
+			}
+			WaitForHeldTransfers(Count);
+		}
+		for(s32 Index = 0; Index < (s32)ARRAY_COUNT(ExpectedOrder); Index += 1)
+		{
+			AssertAlways(strcmp(HeldNames[Index], ExpectedOrder[Index]) == 0);
+		}
+		StopFetchEngine(&PriorityEngine);
+	}
+
+	{
+		// NOTE(ariel) A small response that decompresses past the limit must abort
+		// the transfer rather than fill memory.
+		arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+		curl_response Response =
+		{
+			.CurlHandle = CurlHandle,
+			.Arena = &Arena,
+			.DecompressedSizeLimit = MB(1),
+		};
+		CURLcode CurlResult = Fetch(&Response, Address, "bomb/16777216");
+		curl_easy_reset(CurlHandle);
+		AssertAlways(CurlResult != CURLE_OK);
+		AssertAlways(Response.ExceededSizeLimit);
+		AssertAlways(Response.Data.len <= MB(1));
+		AssertAlways(Response.CompressedByteCount < KB(64));
+		ReleaseResponse(&Response);
+		RestoreArenaFromCheckpoint(Checkpoint);
+	}
+
+	curl_easy_cleanup(CurlHandle);
+	curl_global_cleanup();
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include "arena.h"
 #include "rss.h"
 #include "str.h"
+#include "encoding.h"
 
 #if defined(__linux__)
 #include "memory_linux.c"
@@ -16,6 +17,7 @@
 #include "arena.c"
 #include "rss.c"
 #include "str.c"
+#include "encoding.c"
 
 static string
 LoadFile(arena *Arena, FILE *File)
@@ -37,12 +39,394 @@ LoadFile(arena *Arena, FILE *File)
 	return Contents;
 }
 
+static string
+PrintTreeToString(arena *Arena, RSS_Tree *Tree)
+{
+	char *Buffer = 0;
+	size_t Size = 0;
+	FILE *Stream = open_memstream(&Buffer, &Size); AssertAlways(Stream);
+	RSS_PrintTree(Tree, Stream);
+	fclose(Stream);
+
+	string Result = string_duplicate(Arena, (string){ .str = Buffer, .len = (s32)Size });
+	free(Buffer);
+	return Result;
+}
+
+static string
+TranscodeInPieces(arena *Arena, string Source, s32 PieceSize)
+{
+	UTF8_Transcoder Transcoder = {0};
+	begin_transcode(&Transcoder, Source, (string){0});
+
+	string Result = {0};
+	Result.str = PushBytesToArena(Arena, MAX_TRANSCODED_SIZE(Source.len));
+	for(s32 Offset = 0; Offset < Source.len; Offset += PieceSize)
+	{
+		string Piece = string_substr(Source, Offset, PieceSize);
+		Result.len += transcode_to_utf8(&Transcoder, Result.str + Result.len, Piece, false);
+	}
+	Result.len += transcode_to_utf8(&Transcoder, Result.str + Result.len, (string){0}, true);
+	return Result;
+}
+
+static void
+CheckTranscoding(arena *Arena, string Source, string ContentType, string Expected)
+{
+	AssertAlways(string_match(transcode_document_to_utf8(Arena, Source, ContentType), Expected));
+	if(!ContentType.len)
+	{
+		// NOTE(ariel) Characters split across pieces must come out whole.
+		for(s32 PieceSize = 1; PieceSize <= 5; PieceSize += 1)
+		{
+			AssertAlways(string_match(TranscodeInPieces(Arena, Source, PieceSize), Expected));
+		}
+
+		// NOTE(ariel) A document viewed in place must read the same as its
+		// transcoded copy.
+		string View = {0};
+		AssertAlways(!view_utf8_document(Source, &View) || string_match(View, Expected));
+	}
+}
+
+static RSS_Tree *
+ParseInRanges(arena *Arena, string Source, s32 RangeCount, RSS_Range_List *Ranges)
+{
+	*Ranges = split_rss(Arena, Source, RangeCount);
+	for(s32 Index = Ranges->count - 1; Index >= 0; Index -= 1)
+	{
+		parse_rss_range(&Ranges->ranges[Index]);
+	}
+	RSS_Tree *Tree = stitch_rss(Arena, Source, *Ranges);
+	return Tree;
+}
+
+static s32
+CountStitchedRanges(RSS_Range_List Ranges)
+{
+	s32 Count = 0;
+	for(s32 Index = 0; Index < Ranges.count; Index += 1)
+	{
+		Count += Ranges.ranges[Index].stitched;
+	}
+	return Count;
+}
+
+typedef struct extracted_items extracted_items;
+struct extracted_items
+{
+	arena *Arena;
+	b32 HasTitle;
+	string Title;
+	RSS_Item *FirstItem;
+	RSS_Item *LastItem;
+
+	s32 HintCount;
+	RSS_Name_ID HintNames[64];
+	string HintContents[64];
+
+	// NOTE(ariel) Log which handler each call went to, in order.
+	s32 CallCount;
+	char Calls[1024];
+};
+
+static void
+LogCall(extracted_items *Items, char Call)
+{
+	AssertAlways(Items->CallCount < (s32)ARRAY_COUNT(Items->Calls));
+	Items->Calls[Items->CallCount] = Call;
+	Items->CallCount += 1;
+}
+
+static void
+StoreTitle(void *UserData, string Title)
+{
+	extracted_items *Items = UserData;
+	AssertAlways(!Items->HasTitle);
+	Items->HasTitle = true;
+	Items->Title = Title;
+	LogCall(Items, 't');
+}
+
+static void
+StoreItem(void *UserData, RSS_Item *Item)
+{
+	extracted_items *Items = UserData;
+	RSS_Item *NewItem = PushStructToArena(Items->Arena, RSS_Item);
+	*NewItem = *Item;
+	if(Items->LastItem)
+	{
+		Items->LastItem->next = NewItem;
+	}
+	else
+	{
+		Items->FirstItem = NewItem;
+	}
+	Items->LastItem = NewItem;
+	LogCall(Items, 'i');
+}
+
+static void
+StoreRefreshHint(void *UserData, RSS_Name_ID NameID, string Content)
+{
+	extracted_items *Items = UserData;
+	AssertAlways(Items->HintCount < (s32)ARRAY_COUNT(Items->HintNames));
+	Items->HintNames[Items->HintCount] = NameID;
+	Items->HintContents[Items->HintCount] = Content;
+	Items->HintCount += 1;
+	LogCall(Items, 'h');
+}
+
+static void
+CompareExtractionToTree(arena *Arena, string Source, RSS_Tree *Tree)
+{
+	extracted_items Items = { .Arena = Arena };
+	RSS_Handlers Handlers =
+	{
+		.user_data = &Items,
+		.feed_title = StoreTitle,
+		.item = StoreItem,
+		.refresh_hint = StoreRefreshHint,
+	};
+	RSS_Tree *Result = extract_rss(Arena, Source, &Handlers);
+	AssertAlways(!Result->errors.first);
+	AssertAlways(!Result->root);
+
+	RSS_Tree_Node *Title = find_feed_title(Arena, Tree->root);
+	AssertAlways(Items.HasTitle == (Title != 0));
+	if(Title)
+	{
+		AssertAlways(Items.Title.str == Title->content.str && string_match(Items.Title, Title->content));
+	}
+
+	RSS_Item *Item = Items.FirstItem;
+	for(RSS_Tree_Node *ItemNode = find_item_node(Arena, Tree->root); ItemNode; ItemNode = ItemNode->next_sibling)
+	{
+		if(!is_item_name(ItemNode->name_id))
+		{
+			continue;
+		}
+
+		string Date = {0};
+		RSS_Tree_Node *PubDate = find_item_child_node(ItemNode, RSS_NAME_PUB_DATE);
+		RSS_Tree_Node *Updated = find_item_child_node(ItemNode, RSS_NAME_UPDATED);
+		if(PubDate) Date = PubDate->content;
+		if(Updated) Date = Updated->content;
+
+		RSS_Tree_Node *ItemTitle = find_item_title(ItemNode);
+		string TitleContent = ItemTitle ? ItemTitle->content : (string){0};
+
+		AssertAlways(Item);
+		AssertAlways(string_match(Item->title, TitleContent));
+		AssertAlways(string_match(Item->link, find_link(ItemNode)));
+		AssertAlways(string_match(Item->date, Date));
+		Item = Item->next;
+	}
+	AssertAlways(!Item);
+
+	extracted_items TreeItems = { .Arena = Arena };
+	Handlers.user_data = &TreeItems;
+	extract_rss_from_tree(Arena, Tree, &Handlers);
+	AssertAlways(TreeItems.HasTitle == Items.HasTitle && string_match(TreeItems.Title, Items.Title));
+	Item = Items.FirstItem;
+	for(RSS_Item *TreeItem = TreeItems.FirstItem; TreeItem; TreeItem = TreeItem->next, Item = Item->next)
+	{
+		AssertAlways(Item);
+		AssertAlways(string_match(Item->title, TreeItem->title));
+		AssertAlways(string_match(Item->link, TreeItem->link));
+		AssertAlways(string_match(Item->date, TreeItem->date));
+	}
+	AssertAlways(!Item);
+
+	AssertAlways(TreeItems.HintCount == Items.HintCount);
+	for(s32 Index = 0; Index < Items.HintCount; Index += 1)
+	{
+		AssertAlways(TreeItems.HintNames[Index] == Items.HintNames[Index]);
+		AssertAlways(string_match(TreeItems.HintContents[Index], Items.HintContents[Index]));
+	}
+
+	// NOTE(ariel) Both must call the handlers in the same order, too.
+	AssertAlways(TreeItems.CallCount == Items.CallCount);
+	AssertAlways(!memcmp(TreeItems.Calls, Items.Calls, Items.CallCount));
+}
+
 int
 main(void)
 {
 	arena Arena = {0};
 	InitializeArena(&Arena);
 
+	// NOTE(ariel) Every known name must hash to its own slot.
+	for(RSS_Name_ID NameID = RSS_NAME_UNKNOWN + 1; NameID < RSS_NAME_COUNT; NameID += 1)
+	{
+		AssertAlways(classify_name(name_of_id(NameID)) == NameID);
+	}
+	AssertAlways(classify_name(string_literal("items")) == RSS_NAME_UNKNOWN);
+
+	{
+		string Attributes = string_literal(" href = 'a>b' rel=\"alternate\" broken type=\"x\"");
+		AssertAlways(string_match(find_attribute(Attributes, RSS_NAME_HREF), string_literal("a>b")));
+		AssertAlways(string_match(find_attribute(Attributes, RSS_NAME_REL), string_literal("alternate")));
+		AssertAlways(!find_attribute(Attributes, RSS_NAME_TYPE).str);
+	}
+
+	{
+		// NOTE(ariel) Read the attributes of enclosures, media, and GUIDs from the
+		// children of an item by ID.
+		arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+
+		string Source = string_literal(
+			"<rss><channel><item>"
+			"<guid isPermaLink=\"false\">tag:a,2024:1</guid>"
+			"<enclosure url=\"https://a/1.mp3\" length='1337' type=\"audio/mpeg\"/>"
+			"<media:content url=\"https://a/1.jpg\"/>"
+			"</item></channel></rss>");
+		RSS_Tree *Tree = parse_rss(&Arena, Source);
+		AssertAlways(!Tree->errors.first);
+		RSS_Tree_Node *Item = find_item_node(&Arena, Tree->root);
+		AssertAlways(Item);
+
+		RSS_Tree_Node *GUID = find_item_child_node(Item, RSS_NAME_GUID);
+		AssertAlways(GUID && string_match(GUID->content, string_literal("tag:a,2024:1")));
+		AssertAlways(string_match(find_attribute(GUID->attributes, RSS_NAME_IS_PERMALINK), string_literal("false")));
+
+		RSS_Tree_Node *Enclosure = find_item_child_node(Item, RSS_NAME_ENCLOSURE);
+		AssertAlways(Enclosure);
+		AssertAlways(string_match(find_attribute(Enclosure->attributes, RSS_NAME_URL), string_literal("https://a/1.mp3")));
+		AssertAlways(string_match(find_attribute(Enclosure->attributes, RSS_NAME_LENGTH), string_literal("1337")));
+		AssertAlways(string_match(find_attribute(Enclosure->attributes, RSS_NAME_TYPE), string_literal("audio/mpeg")));
+
+		RSS_Tree_Node *Media = find_item_child_node(Item, RSS_NAME_MEDIA_CONTENT);
+		AssertAlways(Media);
+		AssertAlways(string_match(find_attribute(Media->attributes, RSS_NAME_URL), string_literal("https://a/1.jpg")));
+
+		RestoreArenaFromCheckpoint(Checkpoint);
+	}
+
+	{
+		// NOTE(ariel) Guesses at item boundaries that fall in CDATA, comments,
+		// attribute values, or nested items must not change the tree.
+		string Source = string_literal(
+			"<?xml version=\"1.0\"?><rss><channel><title>t</title>"
+			"<item><title>a</title><description><![CDATA[ <item> ]]></description></item>\n"
+			"<item><!-- <item> --><link>b</link></item> text "
+			"<item><guid isPermaLink='false'>c</guid><x a=\"<item>\"/></item>"
+			"<item><title>d</title><item><title>nested</title></item></item>"
+			"<item/><item><title>e</title></item>"
+			"</channel><item>outside</item></rss>");
+		arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+		string Expected = PrintTreeToString(&Arena, parse_rss(&Arena, Source));
+		s32 StitchedRangeCount = 0;
+		for(s32 RangeCount = 1; RangeCount <= 64; RangeCount += 1)
+		{
+			RSS_Range_List Ranges = {0};
+			RSS_Tree *Tree = ParseInRanges(&Arena, Source, RangeCount, &Ranges);
+			AssertAlways(string_match(Expected, PrintTreeToString(&Arena, Tree)));
+			StitchedRangeCount += CountStitchedRanges(Ranges);
+			release_rss_ranges(Ranges);
+		}
+		AssertAlways(StitchedRangeCount > 0);
+		RestoreArenaFromCheckpoint(Checkpoint);
+	}
+
+	{
+		// NOTE(ariel) Extraction tracks elements up to a fixed depth and must fail
+		// documents that nest deeper rather than skip what it can't track.
+		for(s32 Depth = RSS_MAX_ELEMENT_DEPTH; Depth <= RSS_MAX_ELEMENT_DEPTH + 1; Depth += 1)
+		{
+			arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+			static char Buffer[1024];
+			s32 Length = 0;
+			for(s32 Index = 0; Index < Depth; Index += 1)
+			{
+				Length += snprintf(Buffer + Length, sizeof(Buffer) - Length, "<e>");
+			}
+			for(s32 Index = 0; Index < Depth; Index += 1)
+			{
+				Length += snprintf(Buffer + Length, sizeof(Buffer) - Length, "</e>");
+			}
+
+			extracted_items Items = { .Arena = &Arena };
+			RSS_Handlers Handlers = { .user_data = &Items, .item = StoreItem };
+			RSS_Tree *Result = extract_rss(&Arena, (string){ .str = Buffer, .len = Length }, &Handlers);
+			if(Depth > RSS_MAX_ELEMENT_DEPTH)
+			{
+				AssertAlways(Result->errors.first);
+				AssertAlways(string_match(Result->errors.first->text, string_literal("depth of element exceeds maximum")));
+			}
+			else
+			{
+				AssertAlways(!Result->errors.first);
+			}
+			RestoreArenaFromCheckpoint(Checkpoint);
+		}
+	}
+
+	{
+		// NOTE(ariel) Refresh hints before, between, and after items, and a feed
+		// title that only lies in an item, must reach the handlers in document order
+		// whether the document parses serially or in ranges.
+		string Sources[] =
+		{
+			string_literal(
+				"<rss><channel><title>t</title><ttl>60</ttl>"
+				"<item><title>a</title><ttl>1</ttl></item>"
+				"<sy:updatePeriod>daily</sy:updatePeriod>"
+				"<item><title>b</title></item>"
+				"<skipHours><hour>3</hour><hour>4</hour></skipHours>"
+				"<item><title>c</title></item>"
+				"<sy:updateFrequency>2</sy:updateFrequency></channel></rss>"),
+			string_literal(
+				"<rss><channel><ttl>60</ttl>"
+				"<item><title>a</title></item><item><title>b</title></item>"
+				"<skipHours><hour>5</hour></skipHours></channel></rss>"),
+		};
+		for(s32 SourceIndex = 0; SourceIndex < (s32)ARRAY_COUNT(Sources); SourceIndex += 1)
+		{
+			arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+			CompareExtractionToTree(&Arena, Sources[SourceIndex], parse_rss(&Arena, Sources[SourceIndex]));
+			for(s32 RangeCount = 2; RangeCount <= 8; RangeCount += 1)
+			{
+				RSS_Range_List Ranges = {0};
+				RSS_Tree *Tree = ParseInRanges(&Arena, Sources[SourceIndex], RangeCount, &Ranges);
+				CompareExtractionToTree(&Arena, Sources[SourceIndex], Tree);
+				release_rss_ranges(Ranges);
+			}
+			RestoreArenaFromCheckpoint(Checkpoint);
+		}
+	}
+
+	{
+		arena_checkpoint Checkpoint = SetArenaCheckpoint(&Arena);
+
+		CheckTranscoding(&Arena,
+			string_literal("<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><t>caf\xe9 \x80\x93</t>"), (string){0},
+			string_literal("<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><t>caf\xc3\xa9 \xe2\x82\xac\xe2\x80\x9c</t>"));
+		CheckTranscoding(&Arena,
+			string_literal("<t>caf\xe9</t>"), string_literal("text/xml; charset=\"windows-1252\""),
+			string_literal("<t>caf\xc3\xa9</t>"));
+		CheckTranscoding(&Arena,
+			string_literal("\xef\xbb\xbf<t>\xe2\x82\xac \xf0\x9f\x98\x80</t>"), (string){0},
+			string_literal("<t>\xe2\x82\xac \xf0\x9f\x98\x80</t>"));
+		CheckTranscoding(&Arena,
+			string_literal("<t>\xc3\x28 \xed\xa0\x80 \xe2\x82 \xff</t>\xe2"), (string){0},
+			string_literal("<t>\xef\xbf\xbd( \xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd \xef\xbf\xbd \xef\xbf\xbd</t>\xef\xbf\xbd"));
+		CheckTranscoding(&Arena,
+			string_literal("\xff\xfe<\0t\0>\0\xac\x20=\xd8\0\xde<\0/\0t\0>\0"), (string){0},
+			string_literal("<t>\xe2\x82\xac\xf0\x9f\x98\x80</t>"));
+		CheckTranscoding(&Arena,
+			string_literal("\0<\0?\0x\0m\0l\0?\0>\0<\0t\0>\0a\0b\0c\0d\0e\0f\0g\0h\0i\0\xe9\0<\0/\0t\0>"), (string){0},
+			string_literal("<?xml?><t>abcdefghi\xc3\xa9</t>"));
+
+		string View = {0};
+		AssertAlways(view_utf8_document(string_literal("\xef\xbb\xbf<t>\xef\xbf\xbd \xf0\x9f\x98\x80</t>"), &View));
+		AssertAlways(string_match(View, string_literal("<t>\xef\xbf\xbd \xf0\x9f\x98\x80</t>")));
+		AssertAlways(!view_utf8_document(string_literal("<t>\xf0\x9f\x98</t>"), &View));
+		AssertAlways(!view_utf8_document(string_literal("<t>caf\xe9</t>"), &View));
+
+		RestoreArenaFromCheckpoint(Checkpoint);
+	}
+
 	DIR *Inputs = opendir("./tests/inputs");
 	AssertAlways(Inputs);
 
@@ -61,10 +445,30 @@ main(void)
 			FILE *InputFile = fopen(InputFilePath, "rb"); AssertAlways(InputFile);
 			FILE *OutputFile = fopen(OutputFilePath, "w"); AssertAlways(OutputFile);
 
-			string Source = LoadFile(&Arena, InputFile);
+			// NOTE(ariel) Transcode inputs as the fetch pipeline transcodes responses.
+			string Bytes = LoadFile(&Arena, InputFile);
+			string Source = transcode_document_to_utf8(&Arena, Bytes, (string){0});
+			AssertAlways(string_match(Source, TranscodeInPieces(&Arena, Bytes, 97)));
 			RSS_Tree *Tree = parse_rss(&Arena, Source);
 			RSS_PrintTree(Tree, OutputFile);
 
+			string Expected = PrintTreeToString(&Arena, Tree);
+
+			// NOTE(ariel) Parsing ranges of the source on their own and stitching them
+			// together must produce the same tree as parsing it serially.
+			for(s32 RangeCount = 2; RangeCount <= 32; RangeCount *= 2)
+			{
+				RSS_Range_List Ranges = {0};
+				RSS_Tree *RangedTree = ParseInRanges(&Arena, Source, RangeCount, &Ranges);
+				AssertAlways(string_match(Expected, PrintTreeToString(&Arena, RangedTree)));
+				CompareExtractionToTree(&Arena, Source, RangedTree);
+				release_rss_ranges(Ranges);
+			}
+
+			// NOTE(ariel) Extracting items without building a tree must find the same
+			// title and items as the walks over the tree.
+			CompareExtractionToTree(&Arena, Source, Tree);
+
 			fclose(OutputFile);
 			fclose(InputFile);
 